@@ -0,0 +1,181 @@
+#include "anim_batch_sample.h"
+#include <algorithm>
+#include <cmath>
+
+AnimBatchSample::AnimBatchSample(Skeleton* skeleton, Animation* animation) : m_skeleton(skeleton), m_animation(animation)
+{
+	// Values of the joints without animated tracks, copied into every pose instead of being sampled.
+	if (!animation->resampled)
+	{
+		uint32_t next_animated = 0;
+
+		for (uint32_t i = 0; i < skeleton->num_bones(); i++)
+		{
+			if (next_animated < animation->animated_joints.size() && animation->animated_joints[next_animated] == i)
+				next_animated++;
+			else
+				m_static_joints.push_back(std::make_pair(i, animation->first_keyframe(i)));
+		}
+	}
+}
+
+AnimBatchSample::~AnimBatchSample()
+{
+
+}
+
+void AnimBatchSample::sample(const double* local_times, uint32_t count, Pose* poses)
+{
+	double ticks_per_second = m_animation->ticks_per_second != 0 ? m_animation->ticks_per_second : 25.0;
+	uint32_t num_bones = m_skeleton->num_bones(m_lod);
+
+	m_instances.resize(count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		double ticks = fmod(local_times[i] * ticks_per_second, m_animation->duration_in_ticks);
+
+		if (ticks < 0.0)
+			ticks += m_animation->duration_in_ticks;
+
+		m_instances[i].ticks = ticks;
+		m_instances[i].index = i;
+
+		poses[i].num_keyframes = num_bones;
+	}
+
+	// Sorted by time, consecutive instances read the same or neighbouring keys and a single cursor per channel
+	// only ever has to move forwards.
+	std::sort(m_instances.begin(), m_instances.end(), [](const Instance& a, const Instance& b) { return a.ticks < b.ticks; });
+
+	if (m_animation->resampled)
+	{
+		sample_resampled(count, poses);
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		for (const auto& joint : m_static_joints)
+		{
+			if (joint.first >= num_bones)
+				break;
+
+			poses[i].keyframes[joint.first] = joint.second;
+		}
+	}
+
+	double time_scale = QUANTIZED_TIME_MAX / m_animation->duration_in_ticks;
+
+	for (uint32_t i : m_animation->animated_joints)
+	{
+		// Animated joints are sorted, so the ones outside of the bone LOD are all at the end.
+		if (i >= num_bones)
+			break;
+
+		KeyCursor cursor;
+
+		// Instances take the place of bones in the key streams, so the kernel interpolates many instances at once.
+		for (uint32_t start = 0; start < count; start += MAX_BONES)
+		{
+			uint32_t batch_size = std::min(count - start, (uint32_t)MAX_BONES);
+
+			for (uint32_t j = 0; j < batch_size; j++)
+			{
+				const Instance& instance = m_instances[start + j];
+
+				Keyframe key_1;
+				Keyframe key_2;
+				float factors[3];
+
+				if (m_animation->compressed)
+					find_compressed_channel_keys(m_animation->compressed_channels[i], instance.ticks * time_scale, cursor, key_1, key_2, factors);
+				else
+					find_channel_keys(m_animation->channels[i], instance.ticks, cursor, key_1, key_2, factors);
+
+				if (m_simd)
+				{
+					write_key_stream(m_streams.a, MAX_BONES, j, key_1);
+					write_key_stream(m_streams.b, MAX_BONES, j, key_2);
+
+					m_streams.factors[j] = factors[0];
+					m_streams.factors[MAX_BONES + j] = factors[1];
+					m_streams.factors[2 * MAX_BONES + j] = factors[2];
+				}
+				else
+					poses[instance.index].keyframes[i] = interpolate_keyframe(key_1, key_2, factors, m_rotation_interpolation);
+			}
+
+			if (m_simd)
+			{
+				interpolate_key_streams(m_streams.a, m_streams.b, MAX_BONES, m_streams.factors, MAX_BONES, batch_size, m_rotation_interpolation, m_keyframes);
+
+				for (uint32_t j = 0; j < batch_size; j++)
+					poses[m_instances[start + j].index].keyframes[i] = m_keyframes[j];
+			}
+		}
+	}
+}
+
+void AnimBatchSample::sample_resampled(uint32_t count, Pose* poses)
+{
+	double ticks_per_second = m_animation->ticks_per_second != 0 ? m_animation->ticks_per_second : 25.0;
+	uint32_t num_bones = m_skeleton->num_bones(m_lod);
+	uint32_t stride = m_animation->frame_stride;
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Instance& instance = m_instances[i];
+
+		float factor;
+		uint32_t frame = resampled_frame(instance.ticks, ticks_per_second, m_animation->sample_rate, m_animation->duration_in_ticks, m_animation->frame_count, factor);
+
+		const float* frame_1 = m_animation->frame(frame);
+		const float* frame_2 = m_animation->frame(frame + 1);
+		Pose& pose = poses[instance.index];
+
+		if (m_simd)
+		{
+			std::fill(m_streams.factors, m_streams.factors + 3 * MAX_BONES, factor);
+			interpolate_key_streams(frame_1, frame_2, stride, m_streams.factors, MAX_BONES, num_bones, m_rotation_interpolation, pose.keyframes);
+		}
+		else
+		{
+			float factors[3] = { factor, factor, factor };
+
+			for (uint32_t j = 0; j < num_bones; j++)
+				pose.keyframes[j] = interpolate_keyframe(read_key_stream(frame_1, stride, j), read_key_stream(frame_2, stride, j), factors, m_rotation_interpolation);
+		}
+	}
+}
+
+void AnimBatchSample::set_simd(bool simd)
+{
+	m_simd = simd;
+}
+
+bool AnimBatchSample::simd()
+{
+	return m_simd;
+}
+
+void AnimBatchSample::set_rotation_interpolation(RotationInterpolation mode)
+{
+	m_rotation_interpolation = mode;
+}
+
+RotationInterpolation AnimBatchSample::rotation_interpolation()
+{
+	return m_rotation_interpolation;
+}
+
+
+void AnimBatchSample::set_lod(uint32_t lod)
+{
+	m_lod = lod;
+}
+
+uint32_t AnimBatchSample::lod()
+{
+	return m_lod;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "skeletal_mesh.h"
+#include "anim_simd.h"
+
+// Samples one clip for many instances in a single pass. Instances are sorted by time and processed channel by
+// channel, so the keys of a channel are fetched once and shared by every instance that reads them.
+class AnimBatchSample
+{
+public:
+	AnimBatchSample(Skeleton* skeleton, Animation* animation);
+	~AnimBatchSample();
+
+	// Samples the clip at 'count' local times in seconds, wrapped to the clip duration, writing one Pose per time.
+	void sample(const double* local_times, uint32_t count, Pose* poses);
+	void set_simd(bool simd);
+	bool simd();
+	void set_rotation_interpolation(RotationInterpolation mode);
+	RotationInterpolation rotation_interpolation();
+
+	// Only the joints of the given bone LOD are sampled, see Skeleton::build_lods().
+	void set_lod(uint32_t lod);
+	uint32_t lod();
+
+private:
+	struct Instance
+	{
+		double	 ticks;
+		uint32_t index;
+	};
+
+private:
+	void sample_resampled(uint32_t count, Pose* poses);
+
+private:
+	Skeleton*			  m_skeleton;
+	Animation*			  m_animation;
+	bool				  m_simd = false;
+	RotationInterpolation m_rotation_interpolation = ROTATION_INTERPOLATION_SLERP;
+	uint32_t			  m_lod = 0;
+	std::vector<Instance> m_instances;
+	KeyStreamBuffer		  m_streams;
+	Keyframe			  m_keyframes[MAX_BONES];
+	std::vector<std::pair<uint32_t, Keyframe>> m_static_joints;
+};
@@ -1,6 +1,6 @@
 #include "anim_blend.h"
-#define GLM_ENABLE_EXPERIMENTAL
-#include <gtx/compatibility.hpp>
+#include <algorithm>
+#include <numeric>
 
 AnimBlend::AnimBlend(Skeleton* skeleton) : m_skeleton(skeleton)
 {
@@ -12,160 +12,197 @@ AnimBlend::~AnimBlend()
 
 }
 
-Pose* AnimBlend::blend(Pose* base, Pose* secondary, float t)
+const Pose* AnimBlend::blend(const Pose* base, const Pose* secondary, float t)
 {
-	m_pose.num_keyframes = base->num_keyframes;
+	return blend_joints(base, secondary, t, BLEND_MODE_LERP, nullptr, nullptr);
+}
 
-	for (uint32_t i = 0; i < base->num_keyframes; i++)
-	{
-		m_pose.keyframes[i].translation = glm::lerp(base->keyframes[i].translation, secondary->keyframes[i].translation, t);
-		m_pose.keyframes[i].rotation = glm::slerp(base->keyframes[i].rotation, secondary->keyframes[i].rotation, t);
-		m_pose.keyframes[i].scale = glm::lerp(base->keyframes[i].scale, secondary->keyframes[i].scale, t);
-	}
+const Pose* AnimBlend::blend_partial(const Pose* base, const Pose* secondary, float t, const BoneMask& mask)
+{
+	return blend_joints(base, secondary, t, BLEND_MODE_LERP, &mask, nullptr);
+}
 
-	return &m_pose;
+const Pose* AnimBlend::blend_additive(const Pose* base, const Pose* secondary, float t)
+{
+	return blend_joints(base, secondary, t, BLEND_MODE_ADDITIVE, nullptr, nullptr);
 }
 
-Pose* AnimBlend::blend_partial(Pose* base, Pose* secondary, float t, const std::string& root_joint)
+const Pose* AnimBlend::blend_partial_additive(const Pose* base, const Pose* secondary, float t, const BoneMask& mask)
 {
-	m_pose.num_keyframes = base->num_keyframes;
+	return blend_joints(base, secondary, t, BLEND_MODE_ADDITIVE, &mask, nullptr);
+}
 
-	uint32_t idx = m_skeleton->find_joint_index(root_joint);
-	bool found = false;
-	Joint* joints = m_skeleton->joints();
+const Pose* AnimBlend::blend_additive(const Pose* base, const Pose* secondary, float t, const std::vector<uint32_t>& additive_joints)
+{
+	return blend_joints(base, secondary, t, BLEND_MODE_ADDITIVE, nullptr, &additive_joints);
+}
 
-	if (idx >= 0)
-	{
-		for (uint32_t i = 0; i < base->num_keyframes; i++)
-		{
-			if (i == idx)
-				found = true;
-
-			if (i > idx && joints[i].parent_index < idx)
-				found = false;
-
-			if (found && (joints[i].parent_index >= idx || i == idx))
-			{
-				m_pose.keyframes[i].translation = glm::lerp(base->keyframes[i].translation, secondary->keyframes[i].translation, t);
-				m_pose.keyframes[i].rotation = glm::slerp(base->keyframes[i].rotation, secondary->keyframes[i].rotation, t);
-				m_pose.keyframes[i].scale = glm::lerp(base->keyframes[i].scale, secondary->keyframes[i].scale, t);
-			}
-			else
-			{
-				m_pose.keyframes[i].translation = base->keyframes[i].translation;
-				m_pose.keyframes[i].rotation = base->keyframes[i].rotation;
-				m_pose.keyframes[i].scale = base->keyframes[i].scale;
-			}
-		}
-	}
+const Pose* AnimBlend::blend_partial_additive(const Pose* base, const Pose* secondary, float t, const BoneMask& mask, const std::vector<uint32_t>& additive_joints)
+{
+	return blend_joints(base, secondary, t, BLEND_MODE_ADDITIVE, &mask, &additive_joints);
+}
 
-	return &m_pose;
+const Pose* AnimBlend::blend_additive_with_reference(const Pose* reference, const Pose* secondary, float t)
+{
+	return blend_joints(reference, secondary, t, BLEND_MODE_ADDITIVE_WITH_REFERENCE, nullptr, nullptr);
 }
 
-Pose* AnimBlend::blend_additive(Pose* base, Pose* secondary, float t)
+const Pose* AnimBlend::blend_partial_additive_with_reference(const Pose* reference, const Pose* secondary, float t, const BoneMask& mask)
 {
-	m_pose.num_keyframes = base->num_keyframes;
+	return blend_joints(reference, secondary, t, BLEND_MODE_ADDITIVE_WITH_REFERENCE, &mask, nullptr);
+}
+
+const Pose* AnimBlend::blend_weighted(const Pose* const* poses, const float* weights, uint32_t count)
+{
+	if (count == 0)
+		return nullptr;
 
-	for (uint32_t i = 0; i < base->num_keyframes; i++)
+	m_inputs.clear();
+	m_factors.clear();
+
+	float	 total_weight = 0.0f;
+	uint32_t heaviest = 0;
+
+	for (uint32_t i = 0; i < count; i++)
 	{
-		m_pose.keyframes[i].translation = base->keyframes[i].translation + secondary->keyframes[i].translation * t;
-		m_pose.keyframes[i].rotation = base->keyframes[i].rotation * glm::slerp(glm::quat(1.0f, 0.0f, 0.0f, 0.0f), secondary->keyframes[i].rotation, t);
-		m_pose.keyframes[i].scale = base->keyframes[i].scale + secondary->keyframes[i].scale * t;
+		if (weights[i] > weights[heaviest])
+			heaviest = i;
+
+		if (weights[i] < BLEND_WEIGHT_EPSILON)
+			continue;
+
+		m_inputs.push_back(poses[i]);
+		m_factors.push_back(weights[i]);
+		total_weight += weights[i];
 	}
 
-	return &m_pose;
-}
+	// Nothing contributes enough to be blended, fall back to the closest pose rather than no pose at all.
+	if (m_inputs.empty())
+		return poses[heaviest];
 
-Pose* AnimBlend::blend_partial_additive(Pose* base, Pose* secondary, float t, const std::string& root_joint)
-{
-	m_pose.num_keyframes = base->num_keyframes;
+	if (m_inputs.size() == 1)
+		return m_inputs[0];
 
-	uint32_t idx = m_skeleton->find_joint_index(root_joint);
-	bool found = false;
-	Joint* joints = m_skeleton->joints();
+	const Pose** inputs = &m_inputs[0];
+	float*		 factors = &m_factors[0];
+	uint32_t	 num_inputs = m_inputs.size();
 
-	if (idx >= 0)
+	for (uint32_t i = 0; i < num_inputs; i++)
+		factors[i] /= total_weight;
+
+	m_pose.num_keyframes = inputs[0]->num_keyframes;
+
+	if (m_simd)
+	{
+		m_keyframe_inputs.resize(num_inputs);
+
+		for (uint32_t i = 0; i < num_inputs; i++)
+			m_keyframe_inputs[i] = inputs[i]->keyframes;
+
+		blend_weighted_keyframes(&m_keyframe_inputs[0], factors, num_inputs, m_pose.num_keyframes, m_pose.keyframes);
+
+		return &m_pose;
+	}
+
+	for (uint32_t j = 0; j < m_pose.num_keyframes; j++)
 	{
-		for (uint32_t i = 0; i < base->num_keyframes; i++)
+		const glm::quat& first_rotation = inputs[0]->keyframes[j].rotation;
+
+		glm::vec3 translation = glm::vec3(0.0f);
+		glm::quat rotation = glm::quat(0.0f, 0.0f, 0.0f, 0.0f);
+		glm::vec3 scale = glm::vec3(0.0f);
+
+		for (uint32_t i = 0; i < num_inputs; i++)
 		{
-			if (i == idx)
-				found = true;
-
-			if (i > idx && joints[i].parent_index < idx)
-				found = false;
-
-			if (found && (joints[i].parent_index >= idx || i == idx))
-			{
-				m_pose.keyframes[i].translation = base->keyframes[i].translation + secondary->keyframes[i].translation * t;
-				m_pose.keyframes[i].rotation = base->keyframes[i].rotation * glm::slerp(glm::quat(1.0f, 0.0f, 0.0f, 0.0f), secondary->keyframes[i].rotation, t);
-				m_pose.keyframes[i].scale = base->keyframes[i].scale + secondary->keyframes[i].scale * t;
-			}
-			else
-			{
-				m_pose.keyframes[i].translation = base->keyframes[i].translation;
-				m_pose.keyframes[i].rotation = base->keyframes[i].rotation;
-				m_pose.keyframes[i].scale = base->keyframes[i].scale;
-			}
+			const Keyframe& keyframe = inputs[i]->keyframes[j];
+
+			// q and -q are the same rotation, so flip each one onto the hemisphere of the first to avoid cancellation.
+			float factor = factors[i];
+			float rotation_factor = glm::dot(first_rotation, keyframe.rotation) < 0.0f ? -factor : factor;
+
+			translation += keyframe.translation * factor;
+			rotation = rotation + keyframe.rotation * rotation_factor;
+			scale += keyframe.scale * factor;
 		}
+
+		m_pose.keyframes[j].translation = translation;
+		m_pose.keyframes[j].rotation = glm::normalize(rotation);
+		m_pose.keyframes[j].scale = scale;
 	}
 
 	return &m_pose;
 }
 
-Pose* AnimBlend::blend_additive_with_reference(Pose* reference, Pose* secondary, float t)
+void AnimBlend::set_simd(bool simd)
 {
-	m_pose.num_keyframes = reference->num_keyframes;
+	m_simd = simd;
+}
 
-	for (uint32_t i = 0; i < reference->num_keyframes; i++)
-	{
-		glm::vec3 delta_translation = translation_delta(reference->keyframes[i].translation, secondary->keyframes[i].translation);
-		glm::quat delta_rotation = rotation_delta(reference->keyframes[i].rotation, secondary->keyframes[i].rotation);
-		glm::vec3 delta_scale = scale_delta(reference->keyframes[i].scale, secondary->keyframes[i].scale);
+bool AnimBlend::simd()
+{
+	return m_simd;
+}
 
-		m_pose.keyframes[i].translation = reference->keyframes[i].translation + delta_translation * t;
-		m_pose.keyframes[i].rotation = reference->keyframes[i].rotation * glm::slerp(glm::quat(1.0f, 0.0f, 0.0f, 0.0f), delta_rotation, t);
-		m_pose.keyframes[i].scale = reference->keyframes[i].scale + delta_scale * t;
+const Pose* AnimBlend::blend_joints(const Pose* base, const Pose* secondary, float t, BlendMode mode, const BoneMask* mask, const std::vector<uint32_t>* joints)
+{
+	// Inputs which would be returned unchanged are passed through without a copy.
+	if (t < BLEND_WEIGHT_EPSILON)
+		return base;
+
+	if (mode == BLEND_MODE_LERP && !mask && t > 1.0f - BLEND_WEIGHT_EPSILON)
+		return secondary;
+
+	uint32_t* end = m_joints;
+
+	if (mask && joints)
+		end = std::set_intersection(mask->joints().begin(), mask->joints().end(), joints->begin(), joints->end(), m_joints);
+	else if (mask)
+		end = std::copy(mask->joints().begin(), mask->joints().end(), m_joints);
+	else if (joints)
+		end = std::copy(joints->begin(), joints->end(), m_joints);
+	else
+	{
+		end = m_joints + base->num_keyframes;
+		std::iota(m_joints, end, 0);
 	}
 
-	return &m_pose;
-}
+	// Joints outside of the bone LOD are not part of the pose.
+	uint32_t count = std::lower_bound(m_joints, end, base->num_keyframes) - m_joints;
 
-Pose* AnimBlend::blend_partial_additive_with_reference(Pose* reference, Pose* secondary, float t, const std::string& root_joint)
-{
-	m_pose.num_keyframes = reference->num_keyframes;
+	m_pose.num_keyframes = base->num_keyframes;
+
+	// Joints are gathered in increasing order, so blending all of them needs no scatter.
+	bool dense = count == base->num_keyframes;
 
-	uint32_t idx = m_skeleton->find_joint_index(root_joint);
-	bool found = false;
-	Joint* joints = m_skeleton->joints();
+	if (!dense)
+		std::copy(base->keyframes, base->keyframes + base->num_keyframes, m_pose.keyframes);
 
-	if (idx >= 0)
+	float* weights = m_streams.factors;
+
+	for (uint32_t j = 0; j < count; j++)
+		weights[j] = mask ? t * mask->weight(m_joints[j]) : t;
+
+	if (m_simd)
 	{
-		for (uint32_t i = 0; i < reference->num_keyframes; i++)
+		for (uint32_t j = 0; j < count; j++)
+		{
+			write_key_stream(m_streams.a, MAX_BONES, j, base->keyframes[m_joints[j]]);
+			write_key_stream(m_streams.b, MAX_BONES, j, secondary->keyframes[m_joints[j]]);
+		}
+
+		blend_key_streams(m_streams.a, m_streams.b, MAX_BONES, weights, count, mode, dense ? m_pose.keyframes : m_keyframes);
+
+		if (!dense)
 		{
-			if (i == idx)
-				found = true;
-
-			if (i > idx && joints[i].parent_index < idx)
-				found = false;
-
-			if (found && (joints[i].parent_index >= idx || i == idx))
-			{
-				glm::vec3 delta_translation = translation_delta(reference->keyframes[i].translation, secondary->keyframes[i].translation);
-				glm::quat delta_rotation = rotation_delta(reference->keyframes[i].rotation, secondary->keyframes[i].rotation);
-				glm::vec3 delta_scale = scale_delta(reference->keyframes[i].scale, secondary->keyframes[i].scale);
-
-				m_pose.keyframes[i].translation = reference->keyframes[i].translation + delta_translation * t;
-				m_pose.keyframes[i].rotation = reference->keyframes[i].rotation * glm::slerp(glm::quat(1.0f, 0.0f, 0.0f, 0.0f), delta_rotation, t);
-				m_pose.keyframes[i].scale = reference->keyframes[i].scale + delta_scale * t;
-			}
-			else
-			{
-				m_pose.keyframes[i].translation = reference->keyframes[i].translation;
-				m_pose.keyframes[i].rotation = reference->keyframes[i].rotation;
-				m_pose.keyframes[i].scale = reference->keyframes[i].scale;
-			}
+			for (uint32_t j = 0; j < count; j++)
+				m_pose.keyframes[m_joints[j]] = m_keyframes[j];
 		}
 	}
+	else
+	{
+		for (uint32_t j = 0; j < count; j++)
+			m_pose.keyframes[m_joints[j]] = blend_keyframe(base->keyframes[m_joints[j]], secondary->keyframes[m_joints[j]], weights[j], mode);
+	}
 
 	return &m_pose;
 }
\ No newline at end of file
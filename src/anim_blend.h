@@ -1,21 +1,59 @@
 #pragma once
 
 #include "skeletal_mesh.h"
+#include "anim_simd.h"
+#include "bone_mask.h"
 
+#define BLEND_WEIGHT_EPSILON 1e-4f
+
+// Blends by a factor below BLEND_WEIGHT_EPSILON return the base pose itself, and full (unmasked) blends return the
+// secondary pose itself, so the result is only valid as long as the inputs are.
 class AnimBlend
 {
 public:
 	AnimBlend(Skeleton* skeleton);
 	~AnimBlend();
 
-	Pose* blend(Pose* base, Pose* secondary, float t);
-	Pose* blend_partial(Pose* base, Pose* secondary, float t, const std::string& root_joint);
-	Pose* blend_additive(Pose* base, Pose* secondary, float t);
-	Pose* blend_partial_additive(Pose* base, Pose* secondary, float t, const std::string& root_joint);
-	Pose* blend_additive_with_reference(Pose* reference, Pose* secondary, float t);
-	Pose* blend_partial_additive_with_reference(Pose* reference, Pose* secondary, float t, const std::string& root_joint);
+	const Pose* blend(const Pose* base, const Pose* secondary, float t);
+
+	// Partial blends scale 't' by the weight of each joint in 'mask'; joints outside of it are copied from the base pose.
+	const Pose* blend_partial(const Pose* base, const Pose* secondary, float t, const BoneMask& mask);
+	const Pose* blend_additive(const Pose* base, const Pose* secondary, float t);
+	const Pose* blend_partial_additive(const Pose* base, const Pose* secondary, float t, const BoneMask& mask);
+
+	// Same as above, but only the joints in 'additive_joints' (sorted, see merge_additive_joints()) are blended; every
+	// other joint has an identity delta and is copied from the base pose.
+	const Pose* blend_additive(const Pose* base, const Pose* secondary, float t, const std::vector<uint32_t>& additive_joints);
+	const Pose* blend_partial_additive(const Pose* base, const Pose* secondary, float t, const BoneMask& mask, const std::vector<uint32_t>& additive_joints);
+	const Pose* blend_additive_with_reference(const Pose* reference, const Pose* secondary, float t);
+	const Pose* blend_partial_additive_with_reference(const Pose* reference, const Pose* secondary, float t, const BoneMask& mask);
+
+	// Weighted average of 'count' poses in a single pass over the joints. Weights are normalized and poses weighted below
+	// BLEND_WEIGHT_EPSILON are skipped. Rotations are accumulated on the hemisphere of the first pose and normalized.
+	// A single contributing pose is returned itself. If no weight reaches BLEND_WEIGHT_EPSILON, the pose with the
+	// largest weight is returned; only a 'count' of zero returns nullptr.
+	const Pose* blend_weighted(const Pose* const* poses, const float* weights, uint32_t count);
+
+	// Blends with blend_key_streams() and blend_weighted_keyframes() instead of one joint at a time. Poses stay in Keyframe
+	// form between the sampler and the blend: each pairwise blend gathers the joints it touches into key streams and
+	// writes the result back, which keeps every consumer of Pose unchanged. Results match the scalar path within float
+	// precision (see tools/blend_test.cpp).
+	void set_simd(bool simd);
+	bool simd();
+
+private:
+	// Blends the joints in 'mask' (every joint if null), limited to 'joints' when given. The remaining joints are copied
+	// from the base pose.
+	const Pose* blend_joints(const Pose* base, const Pose* secondary, float t, BlendMode mode, const BoneMask* mask, const std::vector<uint32_t>* joints);
 
 private:
-	Skeleton* m_skeleton;
-	Pose	  m_pose;
+	Skeleton*		m_skeleton;
+	Pose			m_pose;
+	bool			m_simd = false;
+	uint32_t		m_joints[MAX_BONES];
+	KeyStreamBuffer m_streams;
+	Keyframe		m_keyframes[MAX_BONES];
+	std::vector<const Pose*>	 m_inputs; // Poses and normalized weights of the current blend_weighted() call.
+	std::vector<float>			 m_factors;
+	std::vector<const Keyframe*> m_keyframe_inputs;
 };
\ No newline at end of file
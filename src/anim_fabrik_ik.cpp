@@ -1,7 +1,6 @@
 #include "anim_fabrik_ik.h"
 #include <gtc/matrix_transform.hpp>
 #include <gtc/quaternion.hpp>
-#include <logger.h>
 
 // https://zalo.github.io/blog/inverse-kinematics/
 glm::quat rotation_from_two_vectors(glm::vec3 u, glm::vec3 v)
@@ -27,7 +26,7 @@ glm::quat rotation_from_two_vectors(glm::vec3 u, glm::vec3 v)
 	return glm::normalize(glm::quat(real_part, w.x, w.y, w.z));
 }
 
-AnimFabrikIK::AnimFabrikIK(Skeleton* skeleton) : m_skeleton(skeleton)
+AnimFabrikIK::AnimFabrikIK(Skeleton* skeleton) : m_skeleton(skeleton), m_dirty_hierarchy(skeleton)
 {
 
 }
@@ -37,61 +36,174 @@ AnimFabrikIK::~AnimFabrikIK()
 
 }
 
-PoseTransforms* AnimFabrikIK::solve(glm::mat4 model, PoseTransforms* local_transforms, PoseTransforms* global_transforms, const glm::vec3& end_effector, const std::string& start_bone, const std::string& end_bone)
+PoseTransforms* AnimFabrikIK::solve(glm::mat4 model, PoseTransforms* local_transforms, PoseTransforms* global_transforms, const glm::vec3& end_effector, const IKChain& chain, const glm::vec3* pole_target)
 {
-	for (int i = 0; i < m_skeleton->num_bones(); i++)
-		m_transforms.transforms[i] = global_transforms->transforms[i];
+	m_first_modified_joint = m_skeleton->num_bones();
 
-	int32_t start_idx = m_skeleton->find_joint_index(start_bone);
+	if (!chain.valid())
+		return global_transforms;
 
-	if (start_idx == -1)
+	for (uint32_t i = 0; i < chain.num_joints(); i++)
 	{
-		DW_LOG_ERROR("FABRIK IK: Requested start bone not found = " + start_bone);
-		return global_transforms;
+		const glm::mat4& m = global_transforms->transforms[chain.joint(i)];
+		m_source_joint_pos[i] = glm::vec3(m[3][0], m[3][1], m[3][2]);
 	}
 
-	int32_t end_idx = m_skeleton->find_joint_index(end_bone);
+	solve_positions(model, end_effector, chain, pole_target);
+	modify_transforms(chain, global_transforms);
+
+	m_first_modified_joint = m_dirty_hierarchy.first_dirty_joint();
+	m_dirty_hierarchy.update(global_transforms, local_transforms);
+
+	return global_transforms;
+}
+
+Pose* AnimFabrikIK::solve(glm::mat4 model, const Pose* local_pose, Pose* global_pose, const glm::vec3& end_effector, const IKChain& chain, const glm::vec3* pole_target)
+{
+	m_first_modified_joint = m_skeleton->num_bones();
+
+	if (!chain.valid())
+		return global_pose;
+
+	for (uint32_t i = 0; i < chain.num_joints(); i++)
+		m_source_joint_pos[i] = global_pose->keyframes[chain.joint(i)].translation;
+
+	solve_positions(model, end_effector, chain, pole_target);
+	modify_pose(chain, global_pose);
+
+	m_first_modified_joint = m_dirty_hierarchy.first_dirty_joint();
+	m_dirty_hierarchy.update(global_pose, local_pose);
+
+	return global_pose;
+}
+
+void AnimFabrikIK::solve_positions(glm::mat4 model, const glm::vec3& end_effector, const IKChain& chain, const glm::vec3* pole_target)
+{
+	glm::mat4 inv_model = glm::inverse(model);
+	glm::vec3 model_end_effector = glm::vec3(inv_model * glm::vec4(end_effector, 1.0f));
 
-	if (end_idx == -1)
+	if (m_analytic_two_bone && chain.num_joints() == 3)
 	{
-		DW_LOG_ERROR("FABRIK IK: Requested end bone not found = " + end_bone);
-		return global_transforms;
+		// The current middle joint position keeps the bend plane of the input pose.
+		glm::vec3 pole = pole_target ? glm::vec3(inv_model * glm::vec4(*pole_target, 1.0f)) : m_source_joint_pos[1];
+		solve_two_bone(chain, model_end_effector, pole);
+		m_iterations_used = 0;
 	}
+	else
+		iterate(chain, model_end_effector);
+
+	uint32_t count = chain.num_joints();
 
-	int32_t local_end_idx = find_source_chain_data(model, start_idx, end_idx, global_transforms);
+	m_residual = glm::length(m_iteration_joint_pos[count - 1] - model_end_effector);
 
-	for (uint32_t i = 0; i < m_iterations; i++)
+	for (uint32_t i = 0; i < count; i++)
+		m_previous_joint_pos[i] = m_iteration_joint_pos[i];
+
+	m_previous_joints[0] = chain.joint(0);
+	m_previous_joints[1] = chain.joint(count - 1);
+	m_previous_num_joints = count;
+}
+
+void AnimFabrikIK::iterate(const IKChain& chain, const glm::vec3& end_effector)
+{
+	int32_t count = chain.num_joints();
+
+	m_iterations_used = 0;
+
+	glm::vec3 to_target = end_effector - m_source_joint_pos[0];
+	float	  distance = glm::length(to_target);
+
+	// Out of reach: the solution is the chain stretched towards the target, no need to iterate.
+	if (distance >= chain.length() && distance > 0.0f)
 	{
-		backward_ik(local_end_idx, end_effector);
-		forward_ik(local_end_idx, end_effector);
+		glm::vec3 dir = to_target / distance;
+
+		m_iteration_joint_pos[0] = m_source_joint_pos[0];
+
+		for (int32_t i = 1; i < count; i++)
+			m_iteration_joint_pos[i] = m_iteration_joint_pos[i - 1] + dir * chain.bone_lengths()[i - 1];
+
+		return;
 	}
 
-	modify_transforms(model, start_idx, end_idx, local_transforms);
+	initial_positions(chain);
 
-	return &m_transforms;
+	while (m_iterations_used < m_iterations)
+	{
+		backward_ik(count - 1, chain.bone_lengths(), end_effector);
+		forward_ik(count - 1, chain.bone_lengths());
+
+		m_iterations_used++;
+
+		if (glm::length(m_iteration_joint_pos[count - 1] - end_effector) <= m_tolerance)
+			break;
+	}
 }
 
-int32_t AnimFabrikIK::find_source_chain_data(glm::mat4 model, int32_t start_idx, int32_t end_idx, PoseTransforms* global_transforms)
+void AnimFabrikIK::initial_positions(const IKChain& chain)
 {
-	int32_t count = 0;
+	uint32_t count = chain.num_joints();
+
+	bool same_chain = m_previous_num_joints == count && m_previous_joints[0] == chain.joint(0) && m_previous_joints[1] == chain.joint(count - 1);
 
-	for (int32_t i = start_idx; i <= end_idx; i++)
+	if (!m_warm_start || !same_chain)
 	{
-		int32_t idx = count++;
+		for (uint32_t i = 0; i < count; i++)
+			m_iteration_joint_pos[i] = m_source_joint_pos[i];
+
+		return;
+	}
 
-		glm::mat4 m = model * global_transforms->transforms[i];
+	// The previous solution is moved along with the animated root joint, then blended towards the animated pose.
+	for (uint32_t i = 0; i < count; i++)
+	{
+		glm::vec3 previous = m_previous_joint_pos[i] - m_previous_joint_pos[0];
+		glm::vec3 animated = m_source_joint_pos[i] - m_source_joint_pos[0];
 
-		m_source_joint_pos[idx] = glm::vec3(m[3][0], m[3][1], m[3][2]);
-		m_iteration_joint_pos[idx] = m_source_joint_pos[idx];
+		m_iteration_joint_pos[i] = m_source_joint_pos[0] + previous + (animated - previous) * m_warm_start_blend;
 	}
+}
+
+void AnimFabrikIK::solve_two_bone(const IKChain& chain, const glm::vec3& end_effector, const glm::vec3& pole)
+{
+	const glm::vec3& root = m_source_joint_pos[0];
+	float			 upper_length = chain.bone_lengths()[0];
+	float			 lower_length = chain.bone_lengths()[1];
+
+	glm::vec3 to_target = end_effector - root;
+	float	  distance = glm::length(to_target);
+
+	// Direction to the target, or the current direction of the chain if the target sits on the root joint.
+	glm::vec3 dir = distance > 1e-6f ? to_target / distance : glm::normalize(m_source_joint_pos[2] - root);
+
+	// Unreachable targets are clamped to a fully stretched or fully folded chain.
+	distance = glm::clamp(distance, fabsf(upper_length - lower_length), upper_length + lower_length);
+
+	// Bend direction: the part of the pole direction perpendicular to the chain, with fallbacks for a pole on the line.
+	glm::vec3 bend = (pole - root) - dir * glm::dot(pole - root, dir);
 
-	for (int32_t i = 0; i < (count - 1); i++)
-		m_bone_lengths[i] = glm::length(m_source_joint_pos[i] - m_source_joint_pos[i + 1]);
+	if (glm::dot(bend, bend) < 1e-12f)
+		bend = (m_source_joint_pos[1] - root) - dir * glm::dot(m_source_joint_pos[1] - root, dir);
 
-	return count - 1;
+	if (glm::dot(bend, bend) < 1e-12f)
+		bend = fabsf(dir.x) > fabsf(dir.z) ? glm::vec3(-dir.y, dir.x, 0.0f) : glm::vec3(0.0f, -dir.z, dir.y);
+
+	bend = glm::normalize(bend);
+
+	// Angle at the root joint between the chain and the upper bone.
+	float cos_angle = 1.0f;
+
+	if (distance > 1e-6f)
+		cos_angle = glm::clamp((upper_length * upper_length + distance * distance - lower_length * lower_length) / (2.0f * upper_length * distance), -1.0f, 1.0f);
+
+	float sin_angle = sqrtf(1.0f - cos_angle * cos_angle);
+
+	m_iteration_joint_pos[0] = root;
+	m_iteration_joint_pos[1] = root + dir * (upper_length * cos_angle) + bend * (upper_length * sin_angle);
+	m_iteration_joint_pos[2] = root + dir * distance;
 }
 
-void AnimFabrikIK::forward_ik(int32_t end_idx, const glm::vec3& end_effector)
+void AnimFabrikIK::forward_ik(int32_t end_idx, const float* bone_lengths)
 {
 	for (int32_t i = 0; i <= end_idx; i++)
 	{
@@ -100,12 +212,12 @@ void AnimFabrikIK::forward_ik(int32_t end_idx, const glm::vec3& end_effector)
 		else
 		{
 			glm::vec3 dir = glm::normalize(m_iteration_joint_pos[i] - m_iteration_joint_pos[i - 1]);
-			m_iteration_joint_pos[i] = m_iteration_joint_pos[i - 1] + dir * m_bone_lengths[i - 1];
+			m_iteration_joint_pos[i] = m_iteration_joint_pos[i - 1] + dir * bone_lengths[i - 1];
 		}
 	}
 }
 
-void AnimFabrikIK::backward_ik(int32_t end_idx, const glm::vec3& end_effector)
+void AnimFabrikIK::backward_ik(int32_t end_idx, const float* bone_lengths, const glm::vec3& end_effector)
 {
 	for (int32_t i = end_idx; i >= 0; i--)
 	{
@@ -114,56 +226,61 @@ void AnimFabrikIK::backward_ik(int32_t end_idx, const glm::vec3& end_effector)
 		else
 		{
 			glm::vec3 dir = glm::normalize(m_iteration_joint_pos[i] - m_iteration_joint_pos[i + 1]);
-			m_iteration_joint_pos[i] = m_iteration_joint_pos[i + 1] + dir * m_bone_lengths[i];
+			m_iteration_joint_pos[i] = m_iteration_joint_pos[i + 1] + dir * bone_lengths[i];
 		}
 	}
 }
 
-void AnimFabrikIK::modify_transforms(glm::mat4 model, int32_t start_idx, int32_t end_idx, PoseTransforms* local_transforms)
+void AnimFabrikIK::modify_transforms(const IKChain& chain, PoseTransforms* global_transforms)
 {
-	glm::mat4 inv_model = glm::inverse(model);
-
-	for (int32_t i = start_idx; i < end_idx; i++)
+	for (uint32_t i = 0; i < chain.num_joints() - 1; i++)
 	{
+		uint32_t joint = chain.joint(i);
+		uint32_t next_joint = chain.joint(i + 1);
+
 		// Calculate the vector pointing from the one joint to the next in the source transforms.
-		glm::vec3 src_joint_start_pos = glm::vec3(m_transforms.transforms[i][3][0], m_transforms.transforms[i][3][1], m_transforms.transforms[i][3][2]);
-		glm::vec3 src_joint_end_pos = glm::vec3(m_transforms.transforms[i + 1][3][0], m_transforms.transforms[i + 1][3][1], m_transforms.transforms[i + 1][3][2]);
+		glm::vec3 src_joint_start_pos = glm::vec3(global_transforms->transforms[joint][3][0], global_transforms->transforms[joint][3][1], global_transforms->transforms[joint][3][2]);
+		glm::vec3 src_joint_end_pos = glm::vec3(global_transforms->transforms[next_joint][3][0], global_transforms->transforms[next_joint][3][1], global_transforms->transforms[next_joint][3][2]);
 		glm::vec3 src_joint_dir = glm::normalize(glm::vec3(src_joint_end_pos) - glm::vec3(src_joint_start_pos));
 
 		// Calculate the vector pointing from the one joint to the next in the IK transforms.
-		glm::vec4 dst_joint_start_pos = inv_model * glm::vec4(m_iteration_joint_pos[i - start_idx], 1.0f);
-		glm::vec4 dst_joint_end_pos = inv_model * glm::vec4(m_iteration_joint_pos[i - start_idx + 1], 1.0f);
-		glm::vec3 dst_joint_dir = glm::normalize(glm::vec3(dst_joint_end_pos) - glm::vec3(dst_joint_start_pos));
+		glm::vec3 dst_joint_start_pos = m_iteration_joint_pos[i];
+		glm::vec3 dst_joint_dir = glm::normalize(m_iteration_joint_pos[i + 1] - dst_joint_start_pos);
 
 		// Find the quaternion that rotates from source to destination rotations.
 		glm::quat src_to_dst_rotation = rotation_from_two_vectors(src_joint_dir, dst_joint_dir);
 
 		// Find the original rotation of the joint.
-		glm::quat origin_rotation = glm::normalize(glm::quat_cast(m_transforms.transforms[i]));
+		glm::quat origin_rotation = glm::normalize(glm::quat_cast(global_transforms->transforms[joint]));
 
 		// Create a translation matrix from the destination joint position.
 		glm::mat4 translation = glm::mat4(1.0f);
-		translation = glm::translate(translation, glm::vec3(dst_joint_start_pos.x, dst_joint_start_pos.y, dst_joint_start_pos.z));
+		translation = glm::translate(translation, dst_joint_start_pos);
 
 		// Compute the final joint rotation by adding to the original rotation.
 		glm::quat final_rotation = glm::normalize(src_to_dst_rotation * origin_rotation);
 		glm::mat4 rotation = glm::mat4_cast(final_rotation);
 
-		// Compute final joint transform.
-		m_transforms.transforms[i] = translation * rotation;
+		// Compute final joint transform. The next joint is still unmodified when it is read by the next iteration.
+		global_transforms->transforms[joint] = translation * rotation;
+		m_dirty_hierarchy.mark_dirty(joint);
 	}
+}
 
-	Joint* joints = m_skeleton->joints();
+void AnimFabrikIK::modify_pose(const IKChain& chain, Pose* global_pose)
+{
+	for (uint32_t i = 0; i < chain.num_joints() - 1; i++)
+	{
+		uint32_t joint = chain.joint(i);
 
-	int32_t i = end_idx;
+		// Same as modify_transforms(), but the original rotation is read directly instead of recovered from a matrix.
+		glm::vec3 src_joint_dir = glm::normalize(global_pose->keyframes[chain.joint(i + 1)].translation - global_pose->keyframes[joint].translation);
+		glm::vec3 dst_joint_dir = glm::normalize(m_iteration_joint_pos[i + 1] - m_iteration_joint_pos[i]);
 
-	while (joints[i].parent_index > start_idx)
-	{
-		if (joints[i].parent_index == -1)
-			m_transforms.transforms[i] = local_transforms->transforms[i];
-		else
-			m_transforms.transforms[i] = m_transforms.transforms[joints[i].parent_index] * local_transforms->transforms[i];
+		glm::quat src_to_dst_rotation = rotation_from_two_vectors(src_joint_dir, dst_joint_dir);
 
-		i++;
+		global_pose->keyframes[joint].translation = m_iteration_joint_pos[i];
+		global_pose->keyframes[joint].rotation = glm::normalize(src_to_dst_rotation * global_pose->keyframes[joint].rotation);
+		m_dirty_hierarchy.mark_dirty(joint);
 	}
 }
\ No newline at end of file
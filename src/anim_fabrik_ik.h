@@ -1,8 +1,10 @@
 #pragma once
 
 #include "skeletal_mesh.h"
+#include "dirty_hierarchy.h"
+#include "ik_chain.h"
 
-#define MAX_IK_CHAIN_SIZE 8
+#define FABRIK_DEFAULT_TOLERANCE 1e-3f
 
 class AnimFabrikIK
 {
@@ -10,22 +12,70 @@ public:
 	AnimFabrikIK(Skeleton* skeleton);
 	~AnimFabrikIK();
 
-	PoseTransforms* solve(glm::mat4 model, PoseTransforms* local_transforms, PoseTransforms* global_transforms, const glm::vec3& end_effector, const std::string& start_bone, const std::string& end_bone);
+	// Modifies 'global_transforms' in place and returns it: the chain joints are written directly and only their
+	// descendants are recomputed, so solvers can be stacked on the same pose at the cost of the bones they touch.
+	// The chain is solved in model space with its rest pose bone lengths, 'end_effector' is in world space.
+	// Two-bone chains (three joints, e.g. arms and legs) are solved in closed form, bending the middle joint towards the
+	// world space 'pole_target'. Without one the bend plane of the input pose is kept.
+	PoseTransforms* solve(glm::mat4 model, PoseTransforms* local_transforms, PoseTransforms* global_transforms, const glm::vec3& end_effector, const IKChain& chain, const glm::vec3* pole_target = nullptr);
+
+	// Same solve on a model space pose from AnimGlobalTransform::generate_pose(), with 'local_pose' being its input.
+	Pose* solve(glm::mat4 model, const Pose* local_pose, Pose* global_pose, const glm::vec3& end_effector, const IKChain& chain, const glm::vec3* pole_target = nullptr);
+	// Maximum number of iterations; a solve stops earlier once the end joint is within the tolerance (model space
+	// distance) of the target.
 	inline uint32_t num_iterations() { return m_iterations; }
 	inline void set_iterations(uint32_t itr) { m_iterations = itr; }
+	inline float tolerance() { return m_tolerance; }
+	inline void set_tolerance(float tolerance) { m_tolerance = tolerance; }
+
+	// Starts the iterations from the previous solve of the same chain instead of the animated pose, relative to the
+	// animated root joint. 'blend' moves the start towards the animated pose (0 = previous solve, 1 = animated pose) so
+	// the chain keeps following the animation. Call reset_warm_start() after a teleport or animation cut.
+	inline void set_warm_start(bool warm_start, float blend = 0.1f) { m_warm_start = warm_start; m_warm_start_blend = blend; }
+	inline bool warm_start() { return m_warm_start; }
+	inline void reset_warm_start() { m_previous_num_joints = 0; }
+
+	// Statistics of the last solve(): iterations run (zero for the closed-form and out of reach cases) and the model
+	// space distance left between the end joint and the target.
+	inline uint32_t iterations_used() { return m_iterations_used; }
+	inline float residual() { return m_residual; }
+
+	// Uses the iterative solve for two-bone chains as well.
+	inline void set_analytic_two_bone(bool analytic) { m_analytic_two_bone = analytic; }
+	inline bool analytic_two_bone() { return m_analytic_two_bone; }
+
+	// Lowest joint index changed by the last solve(); every joint before it still has its input transform.
+	inline uint32_t first_modified_joint() { return m_first_modified_joint; }
 
 private:
-	int32_t find_source_chain_data(glm::mat4 model, int32_t start_idx, int32_t end_idx, PoseTransforms* global_transforms);
-	void forward_ik(int32_t end_idx, const glm::vec3& end_effector);
-	void backward_ik(int32_t end_idx, const glm::vec3& end_effector);
-	void modify_transforms(glm::mat4 model, int32_t start_idx, int32_t end_idx, PoseTransforms* local_transforms);
+	// Solves for the model space joint positions of the chain in m_source_joint_pos, picking the solver.
+	void solve_positions(glm::mat4 model, const glm::vec3& end_effector, const IKChain& chain, const glm::vec3* pole_target);
+	void iterate(const IKChain& chain, const glm::vec3& end_effector);
+	void initial_positions(const IKChain& chain);
+
+	// Law of cosines: places the end joint at the target (clamped to the reach of the chain) and the middle joint on the
+	// side of 'pole'.
+	void solve_two_bone(const IKChain& chain, const glm::vec3& end_effector, const glm::vec3& pole);
+	void forward_ik(int32_t end_idx, const float* bone_lengths);
+	void backward_ik(int32_t end_idx, const float* bone_lengths, const glm::vec3& end_effector);
+	void modify_transforms(const IKChain& chain, PoseTransforms* global_transforms);
+	void modify_pose(const IKChain& chain, Pose* global_pose);
 
 private:
-	float m_bone_lengths[MAX_IK_CHAIN_SIZE - 1];
 	glm::vec3 m_source_joint_pos[MAX_IK_CHAIN_SIZE];
 	glm::vec3 m_iteration_joint_pos[MAX_IK_CHAIN_SIZE];
+	glm::vec3 m_previous_joint_pos[MAX_IK_CHAIN_SIZE];
+	uint32_t m_previous_joints[2] = { 0, 0 }; // First and last joint of the previously solved chain.
+	uint32_t m_previous_num_joints = 0;
 
 	uint32_t m_iterations = 16;
+	float m_tolerance = FABRIK_DEFAULT_TOLERANCE;
+	bool m_warm_start = false;
+	float m_warm_start_blend = 0.1f;
+	uint32_t m_iterations_used = 0;
+	float m_residual = 0.0f;
+	bool m_analytic_two_bone = true;
+	uint32_t m_first_modified_joint = 0;
 	Skeleton* m_skeleton;
-	PoseTransforms m_transforms;
+	DirtyHierarchy m_dirty_hierarchy;
 };
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "anim_fused_transform.h"
+#include <algorithm>
+
+AnimFusedTransform::AnimFusedTransform(Skeleton* skeleton) : m_skeleton(skeleton)
+{
+	for (int i = 0; i < MAX_BONES; i++)
+	{
+		m_local_transforms.transforms[i] = glm::mat4(1.0f);
+		m_global_transforms.transforms[i] = glm::mat4(1.0f);
+		m_palette.transforms[i] = glm::mat4(1.0f);
+	}
+}
+
+AnimFusedTransform::~AnimFusedTransform()
+{
+
+}
+
+PoseTransforms* AnimFusedTransform::generate_transforms(const Pose* pose)
+{
+	Joint*	 joints = m_skeleton->joints();
+	uint32_t num_bones = std::min(pose->num_keyframes, m_skeleton->num_bones(m_lod));
+
+	for (uint32_t i = 0; i < num_bones; i++)
+	{
+		const glm::vec3& t = pose->keyframes[i].translation;
+		const glm::quat& q = pose->keyframes[i].rotation;
+
+		// Columns of the rotation matrix, as in glm::mat3_cast().
+		float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+		float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+
+		glm::vec3 r0 = glm::vec3(1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy));
+		glm::vec3 r1 = glm::vec3(2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx));
+		glm::vec3 r2 = glm::vec3(2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy));
+
+		glm::mat4& global = m_global_transforms.transforms[i];
+
+		if (joints[i].parent_index == -1)
+		{
+			global[0] = glm::vec4(r0, 0.0f);
+			global[1] = glm::vec4(r1, 0.0f);
+			global[2] = glm::vec4(r2, 0.0f);
+			global[3] = glm::vec4(t, 1.0f);
+		}
+		else
+		{
+			// parent * (translation * rotation), without building the local matrix.
+			const glm::mat4& parent = m_global_transforms.transforms[joints[i].parent_index];
+
+			global[0] = parent[0] * r0.x + parent[1] * r0.y + parent[2] * r0.z;
+			global[1] = parent[0] * r1.x + parent[1] * r1.y + parent[2] * r1.z;
+			global[2] = parent[0] * r2.x + parent[1] * r2.y + parent[2] * r2.z;
+			global[3] = parent[0] * t.x + parent[1] * t.y + parent[2] * t.z + parent[3];
+		}
+
+		m_palette.transforms[i] = global * joints[i].offset_transform;
+
+		if (m_keep_local_transforms)
+		{
+			glm::mat4& local = m_local_transforms.transforms[i];
+
+			local[0] = glm::vec4(r0, 0.0f);
+			local[1] = glm::vec4(r1, 0.0f);
+			local[2] = glm::vec4(r2, 0.0f);
+			local[3] = glm::vec4(t, 1.0f);
+		}
+	}
+
+	// Joints culled by the bone LOD follow their parent rigidly.
+	for (uint32_t i = num_bones; i < m_skeleton->num_bones(); i++)
+	{
+		if (joints[i].parent_index == -1)
+		{
+			m_global_transforms.transforms[i] = glm::mat4(1.0f);
+			m_palette.transforms[i] = glm::mat4(1.0f);
+		}
+		else
+		{
+			m_global_transforms.transforms[i] = m_global_transforms.transforms[joints[i].parent_index];
+			m_palette.transforms[i] = m_palette.transforms[joints[i].parent_index];
+		}
+
+		if (m_keep_local_transforms)
+			m_local_transforms.transforms[i] = glm::mat4(1.0f);
+	}
+
+	return &m_palette;
+}
+
+PoseTransforms* AnimFusedTransform::update_palette(PoseTransforms* global_transforms, uint32_t first_joint)
+{
+	Joint*	 joints = m_skeleton->joints();
+	uint32_t num_bones = m_skeleton->num_bones(m_lod);
+
+	for (uint32_t i = first_joint; i < num_bones; i++)
+		m_palette.transforms[i] = global_transforms->transforms[i] * joints[i].offset_transform;
+
+	for (uint32_t i = std::max(first_joint, num_bones); i < m_skeleton->num_bones(); i++)
+		m_palette.transforms[i] = joints[i].parent_index == -1 ? glm::mat4(1.0f) : m_palette.transforms[joints[i].parent_index];
+
+	return &m_palette;
+}
+
+void AnimFusedTransform::set_keep_local_transforms(bool keep)
+{
+	m_keep_local_transforms = keep;
+}
+
+bool AnimFusedTransform::keep_local_transforms()
+{
+	return m_keep_local_transforms;
+}
+
+void AnimFusedTransform::set_lod(uint32_t lod)
+{
+	m_lod = lod;
+}
+
+uint32_t AnimFusedTransform::lod()
+{
+	return m_lod;
+}
\ No newline at end of file
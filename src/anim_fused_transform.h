@@ -0,0 +1,39 @@
+#pragma once
+
+#include "skeletal_mesh.h"
+
+// Goes from a pose straight to the skinning palette in a single pass over the joints, replacing AnimLocalTransform,
+// AnimGlobalTransform and AnimOffset. Local matrices are never built: each joint's rotation and translation are applied
+// to its parent's model space transform directly. The model space transforms are kept for IK and debug drawing.
+class AnimFusedTransform
+{
+public:
+	AnimFusedTransform(Skeleton* skeleton);
+	~AnimFusedTransform();
+
+	// Returns the skinning palette of 'pose'.
+	PoseTransforms* generate_transforms(const Pose* pose);
+
+	// Rebuilds the palette of the joints from 'first_joint' on out of modified model space transforms, e.g. the output
+	// of an IK solver which only touched joints from there on.
+	PoseTransforms* update_palette(PoseTransforms* global_transforms, uint32_t first_joint);
+
+	inline PoseTransforms* global_transforms() { return &m_global_transforms; }
+
+	// Local transforms are only written when requested, for consumers such as AnimFabrikIK which rebuild descendants.
+	inline PoseTransforms* local_transforms() { return &m_local_transforms; }
+	void set_keep_local_transforms(bool keep);
+	bool keep_local_transforms();
+
+	// Same bone LOD handling as AnimGlobalTransform and AnimOffset.
+	void set_lod(uint32_t lod);
+	uint32_t lod();
+
+private:
+	Skeleton*	   m_skeleton;
+	PoseTransforms m_local_transforms;
+	PoseTransforms m_global_transforms;
+	PoseTransforms m_palette;
+	bool		   m_keep_local_transforms = false;
+	uint32_t	   m_lod = 0;
+};
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "anim_global_transform.h"
+#include <algorithm>
 
 AnimGlobalTransform::AnimGlobalTransform(Skeleton* skeleton) : m_skeleton(skeleton)
 {
@@ -12,16 +13,162 @@ AnimGlobalTransform::~AnimGlobalTransform()
 }
 
 PoseTransforms* AnimGlobalTransform::generate_transforms(PoseTransforms* local_transforms)
+{
+	if (m_simd)
+		generate_levels(local_transforms);
+	else
+	{
+		Joint*	 joints = m_skeleton->joints();
+		uint32_t num_bones = m_skeleton->num_bones(m_lod);
+
+		for (uint32_t i = 0; i < num_bones; i++)
+		{
+			if (joints[i].parent_index == -1)
+				m_transforms.transforms[i] = local_transforms->transforms[i];
+			else
+				m_transforms.transforms[i] = m_transforms.transforms[joints[i].parent_index] * local_transforms->transforms[i];
+		}
+	}
+
+	fill_culled_joints();
+
+	return &m_transforms;
+}
+
+void AnimGlobalTransform::generate_transforms(AnimGlobalTransform* const* instances, PoseTransforms* const* local_transforms, uint32_t count)
+{
+	if (count == 0)
+		return;
+
+	Skeleton* skeleton = instances[0]->m_skeleton;
+	Joint*	  joints = skeleton->joints();
+
+	std::vector<const glm::mat4*> parents(count);
+	std::vector<const glm::mat4*> locals(count);
+	std::vector<glm::mat4*>		  outputs(count);
+
+	for (uint32_t i = 0; i < skeleton->num_bones(); i++)
+	{
+		uint32_t num_pairs = 0;
+
+		for (uint32_t k = 0; k < count; k++)
+		{
+			AnimGlobalTransform* instance = instances[k];
+
+			if (i >= skeleton->num_bones(instance->m_lod))
+				continue;
+
+			if (joints[i].parent_index == -1)
+				instance->m_transforms.transforms[i] = local_transforms[k]->transforms[i];
+			else
+			{
+				parents[num_pairs] = &instance->m_transforms.transforms[joints[i].parent_index];
+				locals[num_pairs] = &local_transforms[k]->transforms[i];
+				outputs[num_pairs] = &instance->m_transforms.transforms[i];
+				num_pairs++;
+			}
+		}
+
+		multiply_transforms(&parents[0], &locals[0], &outputs[0], num_pairs);
+	}
+
+	for (uint32_t k = 0; k < count; k++)
+		instances[k]->fill_culled_joints();
+}
+
+PoseTransforms* AnimGlobalTransform::transforms()
+{
+	return &m_transforms;
+}
+
+void AnimGlobalTransform::generate_levels(PoseTransforms* local_transforms)
 {
 	Joint* joints = m_skeleton->joints();
 
-	for (uint32_t i = 0; i < m_skeleton->num_bones(); i++)
+	const glm::mat4* parents[MAX_BONES];
+	const glm::mat4* locals[MAX_BONES];
+	glm::mat4*		 outputs[MAX_BONES];
+
+	for (uint32_t level = 0; level < m_skeleton->num_levels(); level++)
+	{
+		const uint32_t* level_joints = m_skeleton->level_joints(level);
+		uint32_t		num_joints = m_skeleton->num_level_joints(level, m_lod);
+
+		// The first level holds the roots.
+		if (level == 0)
+		{
+			for (uint32_t i = 0; i < num_joints; i++)
+				m_transforms.transforms[level_joints[i]] = local_transforms->transforms[level_joints[i]];
+
+			continue;
+		}
+
+		for (uint32_t i = 0; i < num_joints; i++)
+		{
+			uint32_t joint = level_joints[i];
+
+			parents[i] = &m_transforms.transforms[joints[joint].parent_index];
+			locals[i] = &local_transforms->transforms[joint];
+			outputs[i] = &m_transforms.transforms[joint];
+		}
+
+		multiply_transforms(parents, locals, outputs, num_joints);
+	}
+}
+
+void AnimGlobalTransform::fill_culled_joints()
+{
+	Joint* joints = m_skeleton->joints();
+
+	for (uint32_t i = m_skeleton->num_bones(m_lod); i < m_skeleton->num_bones(); i++)
+		m_transforms.transforms[i] = joints[i].parent_index == -1 ? glm::mat4(1.0f) : m_transforms.transforms[joints[i].parent_index];
+}
+
+Pose* AnimGlobalTransform::generate_pose(const Pose* local_pose)
+{
+	Joint*	 joints = m_skeleton->joints();
+	uint32_t num_bones = std::min(local_pose->num_keyframes, m_skeleton->num_bones(m_lod));
+
+	for (uint32_t i = 0; i < num_bones; i++)
 	{
 		if (joints[i].parent_index == -1)
-			m_transforms.transforms[i] = local_transforms->transforms[i];
+		{
+			m_pose.keyframes[i] = local_pose->keyframes[i];
+			m_pose.keyframes[i].scale = glm::vec3(1.0f);
+		}
 		else
-			m_transforms.transforms[i] = m_transforms.transforms[joints[i].parent_index] * local_transforms->transforms[i];
+			m_pose.keyframes[i] = compose_keyframe(m_pose.keyframes[joints[i].parent_index], local_pose->keyframes[i]);
 	}
-	
-	return &m_transforms;
+
+	for (uint32_t i = num_bones; i < m_skeleton->num_bones(); i++)
+	{
+		if (joints[i].parent_index == -1)
+			m_pose.keyframes[i] = { glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f) };
+		else
+			m_pose.keyframes[i] = m_pose.keyframes[joints[i].parent_index];
+	}
+
+	m_pose.num_keyframes = m_skeleton->num_bones();
+
+	return &m_pose;
+}
+
+void AnimGlobalTransform::set_lod(uint32_t lod)
+{
+	m_lod = lod;
+}
+
+uint32_t AnimGlobalTransform::lod()
+{
+	return m_lod;
+}
+
+void AnimGlobalTransform::set_simd(bool simd)
+{
+	m_simd = simd;
+}
+
+bool AnimGlobalTransform::simd()
+{
+	return m_simd;
 }
\ No newline at end of file
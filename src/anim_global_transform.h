@@ -1,6 +1,7 @@
 #pragma once
 
 #include "skeletal_mesh.h"
+#include "anim_simd.h"
 
 class AnimGlobalTransform
 {
@@ -9,7 +10,35 @@ public:
 	~AnimGlobalTransform();
 	PoseTransforms* generate_transforms(PoseTransforms* local_transforms);
 
+	// Runs generate_transforms() for 'count' characters sharing one skeleton. Joints are visited once for all of them and
+	// composed across characters with multiply_transforms(), so the batch scales with SIMD width. Each instance keeps its
+	// own LOD; the results are read back with transforms().
+	static void generate_transforms(AnimGlobalTransform* const* instances, PoseTransforms* const* local_transforms, uint32_t count);
+
+	// Result of the last generate_transforms().
+	PoseTransforms* transforms();
+
+	// Same hierarchy, composed as rotation and translation (see compose_keyframe()) instead of 4x4 matrix multiplies.
+	// The result holds model space keyframes for every joint of the skeleton; AnimOffset converts it to matrices.
+	Pose* generate_pose(const Pose* local_pose);
+
+	// Joints outside of the bone LOD take the transform of their parent.
+	void set_lod(uint32_t lod);
+	uint32_t lod();
+
+	// Composes the joints of each depth level (see Skeleton::level_joints()) together with multiply_transforms() instead
+	// of one after another.
+	void set_simd(bool simd);
+	bool simd();
+
+private:
+	void generate_levels(PoseTransforms* local_transforms);
+	void fill_culled_joints();
+
 private:
 	Skeleton*	   m_skeleton;
 	PoseTransforms m_transforms;
+	Pose		   m_pose;
+	uint32_t	   m_lod = 0;
+	bool		   m_simd = false;
 };
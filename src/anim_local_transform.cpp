@@ -3,7 +3,7 @@
 #define GLM_ENABLE_EXPERIMENTAL
 #include <gtx/quaternion.hpp>
 
-AnimLocalTransform::AnimLocalTransform(Skeleton* skeleton) : m_skeleton(skeleton)
+AnimLocalTransform::AnimLocalTransform(Skeleton* skeleton) : m_skeleton(skeleton), m_culled_start(skeleton->num_bones())
 {
 	for (int i = 0; i < MAX_BONES; i++)
 		m_transforms.transforms[i] = glm::mat4(1.0f);
@@ -14,13 +14,20 @@ AnimLocalTransform::~AnimLocalTransform()
 
 }
 
-PoseTransforms* AnimLocalTransform::generate_transforms(Pose* pose)
+PoseTransforms* AnimLocalTransform::generate_transforms(const Pose* pose)
 {
 	Joint* joints = m_skeleton->joints();
 
-	for (uint32_t i = 0; i < m_skeleton->num_bones(); i++)
+	// Poses only hold the joints of their bone LOD.
+	for (uint32_t i = 0; i < pose->num_keyframes; i++)
 		m_transforms.transforms[i] = transform_from_keyframe(pose->keyframes[i]);
 
+	// Joints culled by the bone LOD follow their parent, only written when the LOD changes.
+	for (uint32_t i = pose->num_keyframes; i < m_culled_start; i++)
+		m_transforms.transforms[i] = glm::mat4(1.0f);
+
+	m_culled_start = pose->num_keyframes;
+
 	return &m_transforms;
 }
 
@@ -7,7 +7,7 @@ class AnimLocalTransform
 public:
 	AnimLocalTransform(Skeleton* skeleton);
 	~AnimLocalTransform();
-	PoseTransforms* generate_transforms(Pose* pose);
+	PoseTransforms* generate_transforms(const Pose* pose);
 
 private:
 	glm::mat4 transform_from_keyframe(const Keyframe& keyframe);
@@ -15,4 +15,5 @@ private:
 private:
 	Skeleton*	   m_skeleton;
 	PoseTransforms m_transforms;
+	uint32_t	   m_culled_start; // Joints from here on are outside of the bone LOD and hold the identity.
 };
@@ -4,7 +4,7 @@
 #include <iostream>
 #include <imgui.h>
 
-AnimLookAtIK::AnimLookAtIK(Skeleton* skeleton) : m_skeleton(skeleton)
+AnimLookAtIK::AnimLookAtIK(Skeleton* skeleton) : m_skeleton(skeleton), m_dirty_hierarchy(skeleton)
 {
 
 }
@@ -14,60 +14,60 @@ AnimLookAtIK::~AnimLookAtIK()
 
 }
 
-PoseTransforms* AnimLookAtIK::look_at(PoseTransforms* input, PoseTransforms* input_local, const glm::vec3& target, float max_angle, const std::string& joint)
+PoseTransforms* AnimLookAtIK::look_at(PoseTransforms* input, PoseTransforms* input_local, const glm::vec3& target, float max_angle, uint32_t joint)
 {
-	int32_t idx = m_skeleton->find_joint_index(joint);
+	glm::mat4 bone_mat = input->transforms[joint];
+	bone_mat[3][0] = 0.0f;
+	bone_mat[3][1] = 0.0f;
+	bone_mat[3][2] = 0.0f;
+	bone_mat[3][3] = 1.0f;
 
-	if (idx != -1)
-	{
-		glm::mat4 bone_mat = input->transforms[idx];
-		bone_mat[3][0] = 0.0f;
-		bone_mat[3][1] = 0.0f;
-		bone_mat[3][2] = 0.0f;
-		bone_mat[3][3] = 1.0f;
+	glm::mat4 to_bone_space = glm::inverse(bone_mat);
 
-		glm::mat4 to_bone_space = glm::inverse(bone_mat);
+	glm::vec4 bone_fwd = to_bone_space * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	glm::vec3 bone_fwd_dir = glm::normalize(glm::vec3(bone_fwd.x, bone_fwd.y, bone_fwd.z));
 
-		glm::vec4 bone_fwd = to_bone_space * glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
-		glm::vec3 bone_fwd_dir = glm::normalize(glm::vec3(bone_fwd.x, bone_fwd.y, bone_fwd.z));
+	glm::mat4 global_to_local = glm::inverse(input->transforms[joint]);
 
-		glm::mat4 global_to_local = glm::inverse(input->transforms[idx]);
+	glm::vec4 local_target = to_bone_space * glm::vec4(target, 1.0f);
+	glm::vec3 local_target_dir = glm::normalize(glm::vec3(local_target.x, local_target.y, local_target.z));
 
-		glm::vec4 local_target = to_bone_space * glm::vec4(target, 1.0f);
-		glm::vec3 local_target_dir = glm::normalize(glm::vec3(local_target.x, local_target.y, local_target.z));
+	glm::vec3 rotation_axis = glm::cross(bone_fwd_dir, local_target_dir);
+	rotation_axis = glm::normalize(rotation_axis);
 
-		glm::vec3 rotation_axis = glm::cross(bone_fwd_dir, local_target_dir);
-		rotation_axis = glm::normalize(rotation_axis);
+	float angle = acosf(glm::dot(local_target_dir, bone_fwd_dir));
 
-		float angle = acosf(glm::dot(local_target_dir, bone_fwd_dir));
+	ImGui::Text("Angle: %f, Target: [%f, %f, %f], Bone: [%f, %f, %f]", glm::degrees(angle), local_target_dir.x, local_target_dir.y, local_target_dir.z, bone_fwd_dir.x, bone_fwd_dir.y, bone_fwd_dir.z);
+	//glm::vec3 diff = bone_fwd_dir - local_target_dir;
+	//ImGui::Text("Axis: [%f, %f, %f]", rotation_axis.x, rotation_axis.y, rotation_axis.z);
 
-		ImGui::Text("Angle: %f, Target: [%f, %f, %f], Bone: [%f, %f, %f]", glm::degrees(angle), local_target_dir.x, local_target_dir.y, local_target_dir.z, bone_fwd_dir.x, bone_fwd_dir.y, bone_fwd_dir.z);
-		//glm::vec3 diff = bone_fwd_dir - local_target_dir;
-		//ImGui::Text("Axis: [%f, %f, %f]", rotation_axis.x, rotation_axis.y, rotation_axis.z);
+	angle = std::min(angle, glm::radians(max_angle));
 
-		angle = std::min(angle, glm::radians(max_angle));
+	glm::mat4 rotation_mat = glm::rotate(glm::mat4(1.0f), angle, rotation_axis);
+	input->transforms[joint] = input->transforms[joint] * rotation_mat;
 
-		glm::mat4 rotation_mat = glm::rotate(glm::mat4(1.0f), angle, rotation_axis);
-		input->transforms[idx] = input->transforms[idx] * rotation_mat;
+	m_dirty_hierarchy.mark_dirty(joint);
+	m_dirty_hierarchy.update(input, input_local);
 
-		Joint* joints = m_skeleton->joints();
+	return input;
+}
+
+Pose* AnimLookAtIK::look_at(Pose* input, Pose* input_local, const glm::vec3& target, float max_angle, uint32_t joint)
+{
+	// The inverse of a rotation is its conjugate, no matrix inverse needed.
+	glm::quat to_bone_space = glm::conjugate(input->keyframes[joint].rotation);
+
+	glm::vec3 bone_fwd_dir = glm::normalize(to_bone_space * glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::vec3 local_target_dir = glm::normalize(to_bone_space * target);
+	glm::vec3 rotation_axis = glm::normalize(glm::cross(bone_fwd_dir, local_target_dir));
 
-		for (uint32_t i = (idx + 1); i < m_skeleton->num_bones(); i++)
-		{
-			if (i > idx && joints[i].parent_index < idx)
-				break;
+	float angle = acosf(glm::dot(local_target_dir, bone_fwd_dir));
+	angle = std::min(angle, glm::radians(max_angle));
 
-			if (joints[i].parent_index >= idx)
-			{
-				if (joints[i].parent_index == -1)
-					input->transforms[i] = input_local->transforms[i];
-				else
-					input->transforms[i] = input->transforms[joints[i].parent_index] * input_local->transforms[i];
-			}
-		}
+	input->keyframes[joint].rotation = input->keyframes[joint].rotation * glm::angleAxis(angle, rotation_axis);
 
-		return input;
-	}
+	m_dirty_hierarchy.mark_dirty(joint);
+	m_dirty_hierarchy.update(input, input_local);
 
-	return nullptr;
+	return input;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "skeletal_mesh.h"
+#include "dirty_hierarchy.h"
 
 class AnimLookAtIK
 {
@@ -8,9 +9,13 @@ public:
 	AnimLookAtIK(Skeleton* skeleton);
 	~AnimLookAtIK();
 
-	PoseTransforms* look_at(PoseTransforms* input, PoseTransforms* input_local, const glm::vec3& target, float max_angle, const std::string& joint);
+	// 'joint' is resolved once by the caller with Skeleton::find_joint_index().
+	PoseTransforms* look_at(PoseTransforms* input, PoseTransforms* input_local, const glm::vec3& target, float max_angle, uint32_t joint);
+
+	// Same on a model space pose from AnimGlobalTransform::generate_pose(), reading the joint rotation directly.
+	Pose* look_at(Pose* input, Pose* input_local, const glm::vec3& target, float max_angle, uint32_t joint);
 
 private:
 	Skeleton* m_skeleton;
-	PoseTransforms m_transforms;
+	DirtyHierarchy m_dirty_hierarchy;
 };
\ No newline at end of file
@@ -14,8 +14,74 @@ PoseTransforms* AnimOffset::offset(PoseTransforms* transforms)
 {
 	Joint* joints = m_skeleton->joints();
 
-	for (uint32_t i = 0; i < m_skeleton->num_bones(); i++)
+	uint32_t num_bones = m_skeleton->num_bones(m_lod);
+
+	for (uint32_t i = 0; i < num_bones; i++)
 		m_transforms.transforms[i] = (transforms->transforms[i] * joints[i].offset_transform);
 
+	for (uint32_t i = num_bones; i < m_skeleton->num_bones(); i++)
+		m_transforms.transforms[i] = joints[i].parent_index == -1 ? glm::mat4(1.0f) : m_transforms.transforms[joints[i].parent_index];
+
+	return &m_transforms;
+}
+
+PoseTransforms* AnimOffset::offset(Pose* global_pose)
+{
+	Joint* joints = m_skeleton->joints();
+
+	uint32_t num_bones = m_skeleton->num_bones(m_lod);
+
+	for (uint32_t i = 0; i < num_bones; i++)
+		m_transforms.transforms[i] = keyframe_matrix(global_pose->keyframes[i]) * joints[i].offset_transform;
+
+	for (uint32_t i = num_bones; i < m_skeleton->num_bones(); i++)
+		m_transforms.transforms[i] = joints[i].parent_index == -1 ? glm::mat4(1.0f) : m_transforms.transforms[joints[i].parent_index];
+
 	return &m_transforms;
+}
+
+CompactPoseTransforms* AnimOffset::offset_compact(PoseTransforms* transforms)
+{
+	Joint* joints = m_skeleton->joints();
+
+	uint32_t num_bones = m_skeleton->num_bones(m_lod);
+
+	for (uint32_t i = 0; i < num_bones; i++)
+	{
+		const glm::mat4& global = transforms->transforms[i];
+		const glm::mat4& offset = joints[i].offset_transform;
+
+		for (uint32_t r = 0; r < 3; r++)
+		{
+			glm::vec4 row = glm::vec4(global[0][r], global[1][r], global[2][r], global[3][r]);
+
+			m_compact_transforms.transforms[i].rows[r] = glm::vec4(glm::dot(row, offset[0]), glm::dot(row, offset[1]), glm::dot(row, offset[2]), glm::dot(row, offset[3]));
+		}
+	}
+
+	for (uint32_t i = num_bones; i < m_skeleton->num_bones(); i++)
+	{
+		if (joints[i].parent_index == -1)
+		{
+			m_compact_transforms.transforms[i].rows[0] = glm::vec4(1.0f, 0.0f, 0.0f, 0.0f);
+			m_compact_transforms.transforms[i].rows[1] = glm::vec4(0.0f, 1.0f, 0.0f, 0.0f);
+			m_compact_transforms.transforms[i].rows[2] = glm::vec4(0.0f, 0.0f, 1.0f, 0.0f);
+		}
+		else
+			m_compact_transforms.transforms[i] = m_compact_transforms.transforms[joints[i].parent_index];
+	}
+
+	m_compact_transforms.num_transforms = m_skeleton->num_bones();
+
+	return &m_compact_transforms;
+}
+
+void AnimOffset::set_lod(uint32_t lod)
+{
+	m_lod = lod;
+}
+
+uint32_t AnimOffset::lod()
+{
+	return m_lod;
 }
\ No newline at end of file
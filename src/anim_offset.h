@@ -9,7 +9,20 @@ public:
 	~AnimOffset();
 	PoseTransforms* offset(PoseTransforms* transforms);
 
+	// Palette of a model space pose from AnimGlobalTransform::generate_pose(), the only place that path builds matrices.
+	PoseTransforms* offset(Pose* global_pose);
+
+	// Writes the compact 3x4 palette directly, sized to the skeleton's bone count. The bottom row of an affine matrix
+	// product is constant, so it is neither computed nor stored.
+	CompactPoseTransforms* offset_compact(PoseTransforms* transforms);
+
+	// Joints outside of the bone LOD reuse the skinning transform of their parent, so their vertices follow it rigidly.
+	void set_lod(uint32_t lod);
+	uint32_t lod();
+
 private:
 	Skeleton*	   m_skeleton;
 	PoseTransforms m_transforms;
+	CompactPoseTransforms m_compact_transforms;
+	uint32_t	   m_lod = 0;
 };
@@ -1,11 +1,28 @@
 #include "anim_sample.h"
+#include "pose_cache.h"
 #include <iostream>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <gtx/compatibility.hpp>
+#include <algorithm>
 
 AnimSample::AnimSample(Skeleton* skeleton, Animation* animation) : m_skeleton(skeleton), m_animation(animation), m_playback_rate(1.0f), m_global_time(0.0)
 {
+	// Joints without animated tracks hold the same values on every frame, so they are written once here and
+	// sample() only visits the animated joints.
+	if (!animation->resampled)
+	{
+		for (uint32_t i = 0; i < skeleton->num_bones(); i++)
+			m_pose.keyframes[i] = animation->first_keyframe(i);
+	}
+}
 
+AnimSample::AnimSample(Skeleton* skeleton, StreamedAnimation* animation) : m_skeleton(skeleton), m_animation(nullptr), m_playback_rate(1.0f), m_global_time(0.0)
+{
+	m_streamer = std::make_unique<SegmentStreamer>(animation);
+
+	// Held until the first segment has been read.
+	for (uint32_t i = 0; i < skeleton->num_bones(); i++)
+		m_pose.keyframes[i] = { glm::vec3(0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(1.0f) };
 }
 
 AnimSample::~AnimSample()
@@ -13,164 +30,188 @@ AnimSample::~AnimSample()
 
 }
 
-Pose* AnimSample::sample(double dt)
+const Pose* AnimSample::sample(double dt)
 {
 	m_global_time += (dt * m_playback_rate); // dt is Delta Time in seconds.
 
+	if (m_streamer)
+	{
+		StreamedAnimation* animation = m_streamer->animation();
+
+		float ticks_per_second = (float)(animation->ticks_per_second != 0 ? animation->ticks_per_second : 25.0f);
+		m_local_time = fmod(ticks_per_second * m_global_time, animation->duration_in_ticks);
+		m_local_time_normalized = static_cast<float>(m_local_time) / static_cast<float>(animation->duration_in_ticks);
+		m_pose.num_keyframes = m_skeleton->num_bones(m_lod);
+
+		float factor;
+		uint32_t frame = resampled_frame(m_local_time, ticks_per_second, animation->sample_rate, animation->duration_in_ticks, animation->frame_count, factor);
+		const float* frame_1 = m_streamer->frame(frame);
+
+		// The segment could not be read (logged by the streamer), keep the last pose.
+		if (!frame_1)
+			return &m_pose;
+
+		sample_frames(frame_1, frame_1 + KEY_STREAM_COUNT * animation->frame_stride, animation->frame_stride, factor);
+
+		return &m_pose;
+	}
+
 	float ticks_per_second = (float)(m_animation->ticks_per_second != 0 ? m_animation->ticks_per_second : 25.0f);
 	float time_in_ticks = ticks_per_second * m_global_time; 
 	m_local_time = fmod(time_in_ticks, m_animation->duration_in_ticks);
 	m_local_time_normalized = static_cast<float>(m_local_time) / static_cast<float>(m_animation->duration_in_ticks);
 	
-	m_pose.num_keyframes = m_skeleton->num_bones();
+	m_pose.num_keyframes = m_skeleton->num_bones(m_lod);
+
+	if (m_pose_cache)
+		return m_pose_cache->sample(m_animation, m_local_time / ticks_per_second, m_rotation_interpolation, m_simd, m_lod);
 
-	for (int i = 0; i < m_skeleton->num_bones(); i++)
+	if (m_animation->resampled)
 	{
-		const AnimationChannel& channel = m_animation->channels[i];
+		// Fixed rate frames: the frame index comes straight from the time, no key search needed.
+		float factor;
+		uint32_t frame = resampled_frame(m_local_time, ticks_per_second, m_animation->sample_rate, m_animation->duration_in_ticks, m_animation->frame_count, factor);
+
+		sample_frames(m_animation->frame(frame), m_animation->frame(frame + 1), m_animation->frame_stride, factor);
+
+		return &m_pose;
+	}
+
+	double quantized_time = m_local_time * (QUANTIZED_TIME_MAX / m_animation->duration_in_ticks);
+
+	const std::vector<uint32_t>& animated_joints = m_animation->animated_joints;
 
-		Keyframe result;
+	// Animated joints are sorted, so the ones outside of the bone LOD are all at the end.
+	uint32_t num_animated_joints = std::lower_bound(animated_joints.begin(), animated_joints.end(), m_pose.num_keyframes) - animated_joints.begin();
+
+	for (uint32_t j = 0; j < num_animated_joints; j++)
+	{
+		uint32_t i = animated_joints[j];
+		Keyframe key_1;
+		Keyframe key_2;
+		float factors[3];
 
-		// Calculate interpolated translation
+		if (m_animation->compressed)
+			find_compressed_channel_keys(m_animation->compressed_channels[i], quantized_time, m_cursors[i], key_1, key_2, factors);
+		else
+			find_channel_keys(m_animation->channels[i], m_local_time, m_cursors[i], key_1, key_2, factors);
+
+		if (m_simd)
 		{
-			if (channel.translation_keyframes.size() == 0)
-				result.translation = glm::vec3(0.0f);
-			else
-			{
-				const uint32_t idx_1 = find_translation_key(channel.translation_keyframes, m_local_time);
-				const uint32_t idx_2 = idx_1 + 1;
-
-				if (channel.translation_keyframes.size() == 1)
-					result.translation = channel.translation_keyframes[idx_1].translation;
-				else
-				{
-					float delta = (float)(channel.translation_keyframes[idx_2].time - channel.translation_keyframes[idx_1].time);
-					float factor = (m_local_time - (float)channel.translation_keyframes[idx_1].time) / delta;
-
-					result.translation = interpolate_translation(channel.translation_keyframes[idx_1].translation, channel.translation_keyframes[idx_2].translation, factor);
-				}
-			}
+			// Interpolated below, several bones at a time. Animated joints are packed into consecutive lanes.
+			write_key_stream(m_streams.a, MAX_BONES, j, key_1);
+			write_key_stream(m_streams.b, MAX_BONES, j, key_2);
+
+			m_streams.factors[j] = factors[0];
+			m_streams.factors[MAX_BONES + j] = factors[1];
+			m_streams.factors[2 * MAX_BONES + j] = factors[2];
 		}
-		
-		// Calculate interpolated rotation
+		else
 		{
-			if (channel.rotation_keyframes.size() == 0)
-				result.rotation = glm::quat();
-			else
-			{
-				const uint32_t idx_1 = find_rotation_key(channel.rotation_keyframes, m_local_time);
-				const uint32_t idx_2 = idx_1 + 1;
-
-				if (channel.rotation_keyframes.size() == 1)
-					result.rotation = channel.rotation_keyframes[idx_1].rotation;
-				else
-				{
-					float delta = (float)(channel.rotation_keyframes[idx_2].time - channel.rotation_keyframes[idx_1].time);
-					float factor = (m_local_time - (float)channel.rotation_keyframes[idx_1].time) / delta;
-
-					result.rotation = interpolate_rotation(channel.rotation_keyframes[idx_1].rotation, channel.rotation_keyframes[idx_2].rotation, factor);
-				}
-			}
+			m_pose.keyframes[i].translation = interpolate_translation(key_1.translation, key_2.translation, factors[0]);
+			m_pose.keyframes[i].rotation = interpolate_rotation(key_1.rotation, key_2.rotation, factors[1]);
+			m_pose.keyframes[i].scale = interpolate_scale(key_1.scale, key_2.scale, factors[2]);
 		}
+	}
 
-		// Calculate interpolated scale
-		{
-			if (channel.scale_keyframes.size() == 0)
-				result.scale = glm::vec3(1.0f);
-			else
-			{
-				const uint32_t idx_1 = find_scale_key(channel.scale_keyframes, m_local_time);
-				const uint32_t idx_2 = idx_1 + 1;
-
-				if (channel.scale_keyframes.size() == 1)
-					result.scale = channel.scale_keyframes[idx_1].scale;
-				else
-				{
-					float delta = (float)(channel.scale_keyframes[idx_2].time - channel.scale_keyframes[idx_1].time);
-					float factor = (m_local_time - (float)channel.scale_keyframes[idx_1].time) / delta;
-
-					result.scale = interpolate_scale(channel.scale_keyframes[idx_1].scale, channel.scale_keyframes[idx_2].scale, factor);
-				}
-			}
-		}
+	if (m_simd)
+	{
+		interpolate_key_streams(m_streams.a, m_streams.b, MAX_BONES, m_streams.factors, MAX_BONES, num_animated_joints, m_rotation_interpolation, m_keyframes);
 
-		m_pose.keyframes[i] = result;
+		for (uint32_t j = 0; j < num_animated_joints; j++)
+			m_pose.keyframes[animated_joints[j]] = m_keyframes[j];
 	}
 
 	return &m_pose;
 }
 
-void AnimSample::set_playback_rate(float rate)
+void AnimSample::sample_frames(const float* frame_1, const float* frame_2, uint32_t stride, float factor)
 {
-	if (rate < 0.0f || rate > 1.0f)
+	if (m_simd)
+	{
+		std::fill(m_streams.factors, m_streams.factors + 3 * MAX_BONES, factor);
+		interpolate_key_streams(frame_1, frame_2, stride, m_streams.factors, MAX_BONES, m_pose.num_keyframes, m_rotation_interpolation, m_pose.keyframes);
 		return;
+	}
 
-	m_playback_rate = rate;
+	for (uint32_t i = 0; i < m_pose.num_keyframes; i++)
+	{
+		Keyframe keyframe_1 = read_key_stream(frame_1, stride, i);
+		Keyframe keyframe_2 = read_key_stream(frame_2, stride, i);
+
+		m_pose.keyframes[i].translation = interpolate_translation(keyframe_1.translation, keyframe_2.translation, factor);
+		m_pose.keyframes[i].rotation = interpolate_rotation(keyframe_1.rotation, keyframe_2.rotation, factor);
+		m_pose.keyframes[i].scale = interpolate_scale(keyframe_1.scale, keyframe_2.scale, factor);
+	}
 }
 
-float AnimSample::playback_rate()
+void AnimSample::advance(double dt)
 {
-	return m_playback_rate;
+	m_global_time += (dt * m_playback_rate);
 }
 
-glm::vec3 AnimSample::interpolate_translation(const glm::vec3& a, const glm::vec3& b, float t)
+void AnimSample::set_simd(bool simd)
 {
-	return glm::lerp(a, b, t);
+	m_simd = simd;
 }
 
-glm::vec3 AnimSample::interpolate_scale(const glm::vec3& a, const glm::vec3& b, float t)
+bool AnimSample::simd()
 {
-	return glm::lerp(a, b, t);
+	return m_simd;
 }
 
-glm::quat AnimSample::interpolate_rotation(const glm::quat& a, const glm::quat& b, float t)
+void AnimSample::set_rotation_interpolation(RotationInterpolation mode)
 {
-	return glm::slerp(a, b, t);
+	m_rotation_interpolation = mode;
 }
 
-uint32_t AnimSample::find_translation_key(const std::vector<TranslationKey>& translations, double ticks)
+RotationInterpolation AnimSample::rotation_interpolation()
 {
-	uint32_t idx = 0;
+	return m_rotation_interpolation;
+}
 
-	for (uint32_t i = 0; i < (translations.size() - 1); i++)
-	{
-		if (ticks < translations[i + 1].time)
-		{
-			idx = i;
-			break;
-		}
-	}
+void AnimSample::set_lod(uint32_t lod)
+{
+	m_lod = lod;
+}
+
+uint32_t AnimSample::lod()
+{
+	return m_lod;
+}
 
-	return idx;
+void AnimSample::set_pose_cache(PoseCache* cache)
+{
+	m_pose_cache = cache;
 }
 
-uint32_t AnimSample::find_rotation_key(const std::vector<RotationKey>& rotations, double ticks)
+void AnimSample::set_playback_rate(float rate)
 {
-	uint32_t idx = 0;
+	if (rate < 0.0f || rate > 1.0f)
+		return;
 
-	for (uint32_t i = 0; i < (rotations.size() - 1); i++)
-	{
-		if (ticks < rotations[i + 1].time)
-		{
-			idx = i;
-			break;
-		}
-	}
+	m_playback_rate = rate;
+}
 
-	return idx;
+float AnimSample::playback_rate()
+{
+	return m_playback_rate;
 }
 
-uint32_t AnimSample::find_scale_key(const std::vector<ScaleKey>& scale, double ticks)
+glm::vec3 AnimSample::interpolate_translation(const glm::vec3& a, const glm::vec3& b, float t)
 {
-	uint32_t idx = 0;
+	return glm::lerp(a, b, t);
+}
 
-	for (uint32_t i = 0; i < (scale.size() - 1); i++)
-	{
-		if (ticks < scale[i + 1].time)
-		{
-			idx = i;
-			break;
-		}
-	}
+glm::vec3 AnimSample::interpolate_scale(const glm::vec3& a, const glm::vec3& b, float t)
+{
+	return glm::lerp(a, b, t);
+}
 
-	return idx;
+glm::quat AnimSample::interpolate_rotation(const glm::quat& a, const glm::quat& b, float t)
+{
+	if (m_rotation_interpolation == ROTATION_INTERPOLATION_NLERP)
+		return nlerp_corrected(a, b, t);
+
+	return glm::slerp(a, b, t);
 }
\ No newline at end of file
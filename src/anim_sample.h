@@ -1,23 +1,46 @@
 #pragma once
 
 #include "skeletal_mesh.h"
+#include "anim_simd.h"
+#include "streamed_animation.h"
+#include <memory>
+
+class PoseCache;
 
 class AnimSample
 {
 public:
 	AnimSample(Skeleton* skeleton, Animation* animation);
+
+	// Plays a clip from disk, keeping only the current and next segments in memory.
+	AnimSample(Skeleton* skeleton, StreamedAnimation* animation);
 	~AnimSample();
-	Pose* sample(double dt);
+	const Pose* sample(double dt);
+
+	// Moves the clock forward like sample() without producing a pose, for samplers whose output is currently unused.
+	void advance(double dt);
 	void set_playback_rate(float rate);
 	float playback_rate();
 
+	// Interpolates all bones with the vectorized kernel instead of one bone at a time.
+	void set_simd(bool simd);
+	bool simd();
+	void set_rotation_interpolation(RotationInterpolation mode);
+	RotationInterpolation rotation_interpolation();
+
+	// Only the joints of the given bone LOD are sampled, see Skeleton::build_lods().
+	void set_lod(uint32_t lod);
+	uint32_t lod();
+
+	// Fetches poses from a cache shared with other instances instead of sampling the clip. The returned pose is then
+	// owned by the cache. Pass nullptr to sample directly again.
+	void set_pose_cache(PoseCache* cache);
+
 private:
+	void	  sample_frames(const float* frame_1, const float* frame_2, uint32_t stride, float factor);
 	glm::vec3 interpolate_translation(const glm::vec3& a, const glm::vec3& b, float t);
 	glm::vec3 interpolate_scale(const glm::vec3& a, const glm::vec3& b, float t);
 	glm::quat interpolate_rotation(const glm::quat& a, const glm::quat& b, float t);
-	uint32_t find_translation_key(const std::vector<TranslationKey>& translations, double ticks);
-	uint32_t find_rotation_key(const std::vector<RotationKey>& rotations, double ticks);
-	uint32_t find_scale_key(const std::vector<ScaleKey>& scale, double ticks);
 
 private:
 	double	       m_global_time;
@@ -27,4 +50,12 @@ private:
 	Animation*	   m_animation;
 	float		   m_playback_rate;
 	Pose		   m_pose;
+	KeyCursor	   m_cursors[MAX_BONES];
+	bool		   m_simd = false;
+	RotationInterpolation m_rotation_interpolation = ROTATION_INTERPOLATION_SLERP;
+	KeyStreamBuffer m_streams;
+	Keyframe		m_keyframes[MAX_BONES];
+	std::unique_ptr<SegmentStreamer> m_streamer;
+	PoseCache*		m_pose_cache = nullptr;
+	uint32_t		m_lod = 0;
 };
@@ -0,0 +1,368 @@
+#include "anim_simd.h"
+#include <algorithm>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <gtx/compatibility.hpp>
+
+// Vectorized nlerp_corrected() of quaternions stored as x, y, z, w lanes.
+static inline void simd_nlerp_corrected(const simd_float* qa, const simd_float* qb, simd_float t, simd_float* q)
+{
+	simd_float cos_angle = simd_add(simd_add(simd_mul(qa[0], qb[0]), simd_mul(qa[1], qb[1])), simd_add(simd_mul(qa[2], qb[2]), simd_mul(qa[3], qb[3])));
+	simd_float d = simd_abs(cos_angle);
+
+	// Same factor correction as nlerp_corrected(), evaluated for every lane.
+	simd_float A = simd_add(simd_set(1.0904f), simd_mul(d, simd_add(simd_set(-3.2452f), simd_mul(d, simd_sub(simd_set(3.55645f), simd_mul(d, simd_set(1.43519f)))))));
+	simd_float B = simd_add(simd_set(0.848013f), simd_mul(d, simd_add(simd_set(-1.06021f), simd_mul(d, simd_set(0.215638f)))));
+	simd_float t_half = simd_sub(t, simd_set(0.5f));
+	simd_float k = simd_add(simd_mul(A, simd_mul(t_half, t_half)), B);
+	simd_float ot = simd_add(t, simd_mul(simd_mul(t, simd_mul(t_half, simd_sub(t, simd_set(1.0f)))), k));
+
+	simd_float length_sq = simd_set(0.0f);
+
+	for (uint32_t c = 0; c < 4; c++)
+	{
+		q[c] = simd_lerp(qa[c], simd_flip_sign(qb[c], cos_angle), ot);
+		length_sq = simd_add(length_sq, simd_mul(q[c], q[c]));
+	}
+
+	simd_float inv_length = simd_div(simd_set(1.0f), simd_sqrt(length_sq));
+
+	for (uint32_t c = 0; c < 4; c++)
+		q[c] = simd_mul(q[c], inv_length);
+}
+
+// Coefficients of simd_slerp(): u[i] = 1 / (n * (2n + 1)) and v[i] = n / (2n + 1) for n = i + 1, with the last pair scaled
+// by 1.892 to make up for the truncated terms.
+#define SLERP_TERMS 12
+
+static const float SLERP_U[SLERP_TERMS] = { 0.333333333f, 0.1f, 0.0476190476f, 0.0277777778f, 0.0181818182f, 0.0128205128f, 0.00952380952f, 0.00735294118f, 0.00584795322f, 0.00476190476f, 0.00395256917f, 0.00630666667f };
+static const float SLERP_V[SLERP_TERMS] = { 0.333333333f, 0.4f, 0.428571429f, 0.444444444f, 0.454545455f, 0.461538462f, 0.466666667f, 0.470588235f, 0.473684211f, 0.476190476f, 0.47826087f, 0.90816f };
+
+// sin(t * angle) / sin(angle) as a polynomial in t and cos(angle), so that slerp needs no acos() or sin().
+// https://www.geometrictools.com/Documentation/FastAndAccurateSlerp.pdf
+static inline simd_float simd_slerp_weight(simd_float cos_angle_minus_one, simd_float t)
+{
+	simd_float t_sq = simd_mul(t, t);
+	simd_float weight = simd_set(1.0f);
+
+	for (int32_t i = SLERP_TERMS - 1; i >= 0; i--)
+		weight = simd_add(simd_set(1.0f), simd_mul(simd_mul(simd_sub(simd_mul(simd_set(SLERP_U[i]), t_sq), simd_set(SLERP_V[i])), cos_angle_minus_one), weight));
+
+	return simd_mul(t, weight);
+}
+
+// Vectorized slerp of quaternions stored as x, y, z, w lanes, taking the shortest path like glm::slerp(). The weights
+// are within 1e-6 of the exact ones for every angle.
+static inline void simd_slerp(const simd_float* qa, const simd_float* qb, simd_float t, simd_float* q)
+{
+	simd_float cos_angle = simd_add(simd_add(simd_mul(qa[0], qb[0]), simd_mul(qa[1], qb[1])), simd_add(simd_mul(qa[2], qb[2]), simd_mul(qa[3], qb[3])));
+	simd_float x = simd_sub(simd_abs(cos_angle), simd_set(1.0f));
+
+	simd_float weight_a = simd_slerp_weight(x, simd_sub(simd_set(1.0f), t));
+	simd_float weight_b = simd_flip_sign(simd_slerp_weight(x, t), cos_angle);
+
+	for (uint32_t c = 0; c < 4; c++)
+		q[c] = simd_add(simd_mul(qa[c], weight_a), simd_mul(qb[c], weight_b));
+}
+
+// Hamilton product of quaternions stored as x, y, z, w lanes, matching glm's operator*.
+static inline void simd_quat_mul(const simd_float* p, const simd_float* q, simd_float* r)
+{
+	r[0] = simd_sub(simd_add(simd_add(simd_mul(p[3], q[0]), simd_mul(p[0], q[3])), simd_mul(p[1], q[2])), simd_mul(p[2], q[1]));
+	r[1] = simd_sub(simd_add(simd_add(simd_mul(p[3], q[1]), simd_mul(p[1], q[3])), simd_mul(p[2], q[0])), simd_mul(p[0], q[2]));
+	r[2] = simd_sub(simd_add(simd_add(simd_mul(p[3], q[2]), simd_mul(p[2], q[3])), simd_mul(p[0], q[1])), simd_mul(p[1], q[0]));
+	r[3] = simd_sub(simd_sub(simd_sub(simd_mul(p[3], q[3]), simd_mul(p[0], q[0])), simd_mul(p[1], q[1])), simd_mul(p[2], q[2]));
+}
+
+glm::quat nlerp_corrected(const glm::quat& a, const glm::quat& b, float t)
+{
+	float cos_angle = glm::dot(a, b);
+	float d = fabsf(cos_angle);
+
+	float A = 1.0904f + d * (-3.2452f + d * (3.55645f - d * 1.43519f));
+	float B = 0.848013f + d * (-1.06021f + d * 0.215638f);
+	float k = A * (t - 0.5f) * (t - 0.5f) + B;
+	float ot = t + t * (t - 0.5f) * (t - 1.0f) * k;
+
+	// Take the shortest path, like slerp does.
+	float sign = cos_angle < 0.0f ? -1.0f : 1.0f;
+
+	glm::quat result = glm::quat(a.w + (b.w * sign - a.w) * ot,
+								 a.x + (b.x * sign - a.x) * ot,
+								 a.y + (b.y * sign - a.y) * ot,
+								 a.z + (b.z * sign - a.z) * ot);
+
+	return glm::normalize(result);
+}
+
+Keyframe interpolate_keyframe(const Keyframe& a, const Keyframe& b, const float* factors, RotationInterpolation mode)
+{
+	Keyframe result;
+
+	result.translation = glm::lerp(a.translation, b.translation, factors[0]);
+	result.rotation = mode == ROTATION_INTERPOLATION_NLERP ? nlerp_corrected(a.rotation, b.rotation, factors[1]) : glm::slerp(a.rotation, b.rotation, factors[1]);
+	result.scale = glm::lerp(a.scale, b.scale, factors[2]);
+
+	return result;
+}
+
+void interpolate_key_streams(const float* a, const float* b, uint32_t stride, const float* factors, uint32_t factor_stride, uint32_t count, RotationInterpolation mode, Keyframe* output)
+{
+	DW_ALIGNED(32) float result[KEY_STREAM_COUNT][SIMD_WIDTH];
+
+	for (uint32_t i = 0; i < count; i += SIMD_WIDTH)
+	{
+		simd_float translation_factor = simd_load(&factors[i]);
+		simd_float rotation_factor = simd_load(&factors[factor_stride + i]);
+		simd_float scale_factor = simd_load(&factors[2 * factor_stride + i]);
+
+		for (uint32_t c = 0; c < 3; c++)
+		{
+			uint32_t t = (KEY_STREAM_TRANSLATION_X + c) * stride + i;
+			uint32_t s = (KEY_STREAM_SCALE_X + c) * stride + i;
+
+			simd_store(result[KEY_STREAM_TRANSLATION_X + c], simd_lerp(simd_load(&a[t]), simd_load(&b[t]), translation_factor));
+			simd_store(result[KEY_STREAM_SCALE_X + c], simd_lerp(simd_load(&a[s]), simd_load(&b[s]), scale_factor));
+		}
+
+		if (mode == ROTATION_INTERPOLATION_NLERP)
+		{
+			simd_float qa[4];
+			simd_float qb[4];
+
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				qa[c] = simd_load(&a[(KEY_STREAM_ROTATION_X + c) * stride + i]);
+				qb[c] = simd_load(&b[(KEY_STREAM_ROTATION_X + c) * stride + i]);
+			}
+
+			simd_float q[4];
+			simd_nlerp_corrected(qa, qb, rotation_factor, q);
+
+			for (uint32_t c = 0; c < 4; c++)
+				simd_store(result[KEY_STREAM_ROTATION_X + c], q[c]);
+		}
+
+		uint32_t lanes = std::min(count - i, (uint32_t)SIMD_WIDTH);
+
+		for (uint32_t j = 0; j < lanes; j++)
+		{
+			Keyframe& keyframe = output[i + j];
+
+			keyframe.translation = glm::vec3(result[KEY_STREAM_TRANSLATION_X][j], result[KEY_STREAM_TRANSLATION_Y][j], result[KEY_STREAM_TRANSLATION_Z][j]);
+			keyframe.scale = glm::vec3(result[KEY_STREAM_SCALE_X][j], result[KEY_STREAM_SCALE_Y][j], result[KEY_STREAM_SCALE_Z][j]);
+
+			if (mode == ROTATION_INTERPOLATION_NLERP)
+				keyframe.rotation = glm::quat(result[KEY_STREAM_ROTATION_W][j], result[KEY_STREAM_ROTATION_X][j], result[KEY_STREAM_ROTATION_Y][j], result[KEY_STREAM_ROTATION_Z][j]);
+			else
+				keyframe.rotation = glm::slerp(read_key_stream_rotation(a, stride, i + j), read_key_stream_rotation(b, stride, i + j), factors[factor_stride + i + j]);
+		}
+	}
+}
+
+
+Keyframe blend_keyframe(const Keyframe& a, const Keyframe& b, float t, BlendMode mode)
+{
+	Keyframe result;
+
+	if (mode == BLEND_MODE_LERP)
+	{
+		result.translation = glm::lerp(a.translation, b.translation, t);
+		result.rotation = glm::slerp(a.rotation, b.rotation, t);
+		result.scale = glm::lerp(a.scale, b.scale, t);
+	}
+	else
+	{
+		glm::vec3 delta_translation = b.translation;
+		glm::quat delta_rotation = b.rotation;
+		glm::vec3 delta_scale = b.scale;
+
+		if (mode == BLEND_MODE_ADDITIVE_WITH_REFERENCE)
+		{
+			delta_translation = translation_delta(a.translation, b.translation);
+			delta_rotation = rotation_delta(a.rotation, b.rotation);
+			delta_scale = scale_delta(a.scale, b.scale);
+		}
+
+		result.translation = a.translation + delta_translation * t;
+		result.rotation = a.rotation * glm::slerp(glm::quat(1.0f, 0.0f, 0.0f, 0.0f), delta_rotation, t);
+		result.scale = a.scale + delta_scale * t;
+	}
+
+	return result;
+}
+
+void blend_key_streams(const float* a, const float* b, uint32_t stride, const float* weights, uint32_t count, BlendMode mode, Keyframe* output)
+{
+	DW_ALIGNED(32) float result[KEY_STREAM_COUNT][SIMD_WIDTH];
+
+	for (uint32_t i = 0; i < count; i += SIMD_WIDTH)
+	{
+		simd_float factor = simd_load(&weights[i]);
+		simd_float qa[4];
+		simd_float qb[4];
+		simd_float q[4];
+
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			qa[c] = simd_load(&a[(KEY_STREAM_ROTATION_X + c) * stride + i]);
+			qb[c] = simd_load(&b[(KEY_STREAM_ROTATION_X + c) * stride + i]);
+		}
+
+		if (mode == BLEND_MODE_LERP)
+		{
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				uint32_t tr = (KEY_STREAM_TRANSLATION_X + c) * stride + i;
+				uint32_t sc = (KEY_STREAM_SCALE_X + c) * stride + i;
+
+				simd_store(result[KEY_STREAM_TRANSLATION_X + c], simd_lerp(simd_load(&a[tr]), simd_load(&b[tr]), factor));
+				simd_store(result[KEY_STREAM_SCALE_X + c], simd_lerp(simd_load(&a[sc]), simd_load(&b[sc]), factor));
+			}
+
+			simd_slerp(qa, qb, factor, q);
+		}
+		else
+		{
+			for (uint32_t c = 0; c < 3; c++)
+			{
+				uint32_t tr = (KEY_STREAM_TRANSLATION_X + c) * stride + i;
+				uint32_t sc = (KEY_STREAM_SCALE_X + c) * stride + i;
+
+				simd_float base_translation = simd_load(&a[tr]);
+				simd_float base_scale = simd_load(&a[sc]);
+				simd_float delta_translation = simd_load(&b[tr]);
+				simd_float delta_scale = simd_load(&b[sc]);
+
+				if (mode == BLEND_MODE_ADDITIVE_WITH_REFERENCE)
+				{
+					delta_translation = simd_sub(delta_translation, base_translation);
+					delta_scale = simd_div(delta_scale, base_scale);
+				}
+
+				simd_store(result[KEY_STREAM_TRANSLATION_X + c], simd_add(base_translation, simd_mul(delta_translation, factor)));
+				simd_store(result[KEY_STREAM_SCALE_X + c], simd_add(base_scale, simd_mul(delta_scale, factor)));
+			}
+
+			simd_float delta[4];
+
+			if (mode == BLEND_MODE_ADDITIVE_WITH_REFERENCE)
+			{
+				simd_float conjugate[4] = { simd_sub(simd_set(0.0f), qa[0]), simd_sub(simd_set(0.0f), qa[1]), simd_sub(simd_set(0.0f), qa[2]), qa[3] };
+				simd_quat_mul(conjugate, qb, delta);
+			}
+			else
+			{
+				for (uint32_t c = 0; c < 4; c++)
+					delta[c] = qb[c];
+			}
+
+			simd_float identity[4] = { simd_set(0.0f), simd_set(0.0f), simd_set(0.0f), simd_set(1.0f) };
+			simd_float scaled_delta[4];
+
+			simd_slerp(identity, delta, factor, scaled_delta);
+			simd_quat_mul(qa, scaled_delta, q);
+		}
+
+		for (uint32_t c = 0; c < 4; c++)
+			simd_store(result[KEY_STREAM_ROTATION_X + c], q[c]);
+
+		uint32_t lanes = std::min(count - i, (uint32_t)SIMD_WIDTH);
+
+		for (uint32_t j = 0; j < lanes; j++)
+			output[i + j] = read_key_stream(&result[0][0], SIMD_WIDTH, j);
+	}
+}
+
+void blend_weighted_keyframes(const Keyframe* const* poses, const float* weights, uint32_t num_poses, uint32_t count, Keyframe* output)
+{
+	static_assert(sizeof(Keyframe) == KEY_STREAM_COUNT * sizeof(float), "Keyframes are summed as flat float arrays");
+
+	// Every component is a plain weighted sum, so the poses are accumulated as flat arrays without transposing them.
+	float*	 result = reinterpret_cast<float*>(output);
+	uint32_t size = count * KEY_STREAM_COUNT;
+	uint32_t simd_size = size - size % SIMD_WIDTH;
+
+	for (uint32_t p = 0; p < num_poses; p++)
+	{
+		const float* input = reinterpret_cast<const float*>(poses[p]);
+		simd_float	 weight = simd_set(weights[p]);
+		uint32_t	 i = 0;
+
+		if (p == 0)
+		{
+			for (; i < simd_size; i += SIMD_WIDTH)
+				simd_store(&result[i], simd_mul(simd_load(&input[i]), weight));
+
+			for (; i < size; i++)
+				result[i] = input[i] * weights[p];
+		}
+		else
+		{
+			for (; i < simd_size; i += SIMD_WIDTH)
+				simd_store(&result[i], simd_add(simd_load(&result[i]), simd_mul(simd_load(&input[i]), weight)));
+
+			for (; i < size; i++)
+				result[i] += input[i] * weights[p];
+		}
+	}
+
+	// Rotations on the other hemisphere than the first pose were added with the wrong sign, subtract them twice.
+	for (uint32_t p = 1; p < num_poses; p++)
+	{
+		for (uint32_t j = 0; j < count; j++)
+		{
+			if (glm::dot(poses[0][j].rotation, poses[p][j].rotation) < 0.0f)
+				output[j].rotation = output[j].rotation - poses[p][j].rotation * (2.0f * weights[p]);
+		}
+	}
+
+	for (uint32_t j = 0; j < count; j++)
+		output[j].rotation = glm::normalize(output[j].rotation);
+}
+
+void multiply_transforms(const glm::mat4* const* parents, const glm::mat4* const* locals, glm::mat4* const* outputs, uint32_t count)
+{
+	DW_ALIGNED(32) float a[16][SIMD_WIDTH] = {};
+	DW_ALIGNED(32) float b[16][SIMD_WIDTH] = {};
+	DW_ALIGNED(32) float result[16][SIMD_WIDTH];
+
+	for (uint32_t i = 0; i < count; i += SIMD_WIDTH)
+	{
+		uint32_t num_lanes = std::min(count - i, uint32_t(SIMD_WIDTH));
+
+		// One stream per matrix element. Unused lanes keep earlier values and are never written back.
+		for (uint32_t l = 0; l < num_lanes; l++)
+		{
+			const float* parent = &(*parents[i + l])[0][0];
+			const float* local = &(*locals[i + l])[0][0];
+
+			for (uint32_t e = 0; e < 16; e++)
+			{
+				a[e][l] = parent[e];
+				b[e][l] = local[e];
+			}
+		}
+
+		simd_float parent[16];
+
+		for (uint32_t e = 0; e < 16; e++)
+			parent[e] = simd_load(a[e]);
+
+		// Column c of the result is the parent's columns weighted by column c of the local matrix, summed in glm's order.
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			simd_float local[4] = { simd_load(b[c * 4]), simd_load(b[c * 4 + 1]), simd_load(b[c * 4 + 2]), simd_load(b[c * 4 + 3]) };
+
+			for (uint32_t r = 0; r < 4; r++)
+				simd_store(result[c * 4 + r], simd_add(simd_add(simd_add(simd_mul(parent[r], local[0]), simd_mul(parent[4 + r], local[1])), simd_mul(parent[8 + r], local[2])), simd_mul(parent[12 + r], local[3])));
+		}
+
+		for (uint32_t l = 0; l < num_lanes; l++)
+		{
+			float* output = &(*outputs[i + l])[0][0];
+
+			for (uint32_t e = 0; e < 16; e++)
+				output[e] = result[e][l];
+		}
+	}
+}
\ No newline at end of file
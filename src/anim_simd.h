@@ -0,0 +1,110 @@
+#pragma once
+
+#include "animation.h"
+
+// Thin wrappers over the widest instruction set the compiler targets. Every kernel is written against these
+// so that it also builds (with a width of one) on targets without SSE2 such as Emscripten.
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+#define SIMD_WIDTH 8
+
+typedef __m256 simd_float;
+
+inline simd_float simd_load(const float* p) { return _mm256_loadu_ps(p); }
+inline void		  simd_store(float* p, simd_float v) { _mm256_storeu_ps(p, v); }
+inline simd_float simd_set(float v) { return _mm256_set1_ps(v); }
+inline simd_float simd_add(simd_float a, simd_float b) { return _mm256_add_ps(a, b); }
+inline simd_float simd_sub(simd_float a, simd_float b) { return _mm256_sub_ps(a, b); }
+inline simd_float simd_mul(simd_float a, simd_float b) { return _mm256_mul_ps(a, b); }
+inline simd_float simd_div(simd_float a, simd_float b) { return _mm256_div_ps(a, b); }
+inline simd_float simd_sqrt(simd_float a) { return _mm256_sqrt_ps(a); }
+inline simd_float simd_abs(simd_float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+inline simd_float simd_flip_sign(simd_float a, simd_float s) { return _mm256_xor_ps(a, _mm256_and_ps(s, _mm256_set1_ps(-0.0f))); }
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+#define SIMD_WIDTH 4
+
+typedef __m128 simd_float;
+
+inline simd_float simd_load(const float* p) { return _mm_loadu_ps(p); }
+inline void		  simd_store(float* p, simd_float v) { _mm_storeu_ps(p, v); }
+inline simd_float simd_set(float v) { return _mm_set1_ps(v); }
+inline simd_float simd_add(simd_float a, simd_float b) { return _mm_add_ps(a, b); }
+inline simd_float simd_sub(simd_float a, simd_float b) { return _mm_sub_ps(a, b); }
+inline simd_float simd_mul(simd_float a, simd_float b) { return _mm_mul_ps(a, b); }
+inline simd_float simd_div(simd_float a, simd_float b) { return _mm_div_ps(a, b); }
+inline simd_float simd_sqrt(simd_float a) { return _mm_sqrt_ps(a); }
+inline simd_float simd_abs(simd_float a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+inline simd_float simd_flip_sign(simd_float a, simd_float s) { return _mm_xor_ps(a, _mm_and_ps(s, _mm_set1_ps(-0.0f))); }
+#else
+#include <cmath>
+
+#define SIMD_WIDTH 1
+
+typedef float simd_float;
+
+inline simd_float simd_load(const float* p) { return *p; }
+inline void		  simd_store(float* p, simd_float v) { *p = v; }
+inline simd_float simd_set(float v) { return v; }
+inline simd_float simd_add(simd_float a, simd_float b) { return a + b; }
+inline simd_float simd_sub(simd_float a, simd_float b) { return a - b; }
+inline simd_float simd_mul(simd_float a, simd_float b) { return a * b; }
+inline simd_float simd_div(simd_float a, simd_float b) { return a / b; }
+inline simd_float simd_sqrt(simd_float a) { return sqrtf(a); }
+inline simd_float simd_abs(simd_float a) { return fabsf(a); }
+inline simd_float simd_flip_sign(simd_float a, simd_float s) { return s < 0.0f ? -a : a; }
+#endif
+
+inline simd_float simd_lerp(simd_float a, simd_float b, simd_float t) { return simd_add(a, simd_mul(simd_sub(b, a), t)); }
+
+// Surrounding keys and interpolation factors of up to MAX_BONES lanes, the input of interpolate_key_streams().
+struct KeyStreamBuffer
+{
+	DW_ALIGNED(32) float a[KEY_STREAM_COUNT * MAX_BONES];
+	DW_ALIGNED(32) float b[KEY_STREAM_COUNT * MAX_BONES];
+	DW_ALIGNED(32) float factors[3 * MAX_BONES];
+};
+
+enum RotationInterpolation
+{
+	ROTATION_INTERPOLATION_SLERP,
+	ROTATION_INTERPOLATION_NLERP
+};
+
+// Normalized lerp with a correction of the interpolation factor which brings the result within 1e-3 radians of slerp.
+// http://zeux.io/2015/07/23/approximating-slerp/
+extern glm::quat nlerp_corrected(const glm::quat& a, const glm::quat& b, float t);
+
+// Scalar interpolation of a single keyframe, using the same rotation interpolation as the vectorized kernel.
+extern Keyframe interpolate_keyframe(const Keyframe& a, const Keyframe& b, const float* factors, RotationInterpolation mode);
+
+// Interpolates 'count' bones between the key streams 'a' and 'b' (stream k of a bone lives at k * stride + bone).
+// 'factors' holds three streams of 'factor_stride' interpolation factors for translation, rotation and scale.
+// Strides must be padded to a multiple of SIMD_WIDTH. Translation and scale are always vectorized, rotation only in NLERP mode.
+extern void interpolate_key_streams(const float* a, const float* b, uint32_t stride, const float* factors, uint32_t factor_stride, uint32_t count, RotationInterpolation mode, Keyframe* output);
+
+
+enum BlendMode
+{
+	BLEND_MODE_LERP,
+	BLEND_MODE_ADDITIVE,
+	BLEND_MODE_ADDITIVE_WITH_REFERENCE
+};
+
+// Scalar reference of blend_key_streams() for a single bone: 'a' is the base (or reference) key, 'b' the secondary one.
+extern Keyframe blend_keyframe(const Keyframe& a, const Keyframe& b, float t, BlendMode mode);
+
+// Blends 'count' bones of the key streams 'a' and 'b' (laid out as in interpolate_key_streams()) by the per-bone factors
+// in 'weights', padded like the streams. Rotations are slerped with a polynomial that needs no acos() or sin(), and match
+// blend_keyframe() within 1e-5 radians (see tools/blend_test.cpp).
+extern void blend_key_streams(const float* a, const float* b, uint32_t stride, const float* weights, uint32_t count, BlendMode mode, Keyframe* output);
+
+// Weighted average of the first 'count' keyframes of 'num_poses' poses, one normalized weight per pose. Rotations are
+// accumulated on the hemisphere of the first pose and normalized. 'output' must not be one of the inputs.
+extern void blend_weighted_keyframes(const Keyframe* const* poses, const float* weights, uint32_t num_poses, uint32_t count, Keyframe* output);
+
+// Writes parents[i] * locals[i] to outputs[i] for 'count' independent matrix pairs, SIMD_WIDTH pairs at a time. Matches
+// glm's operator* exactly. An output must not be the parent or local matrix of another pair in the same call.
+extern void multiply_transforms(const glm::mat4* const* parents, const glm::mat4* const* locals, glm::mat4* const* outputs, uint32_t count);
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "anim_update_lod.h"
+#define GLM_ENABLE_EXPERIMENTAL
+#include <gtx/compatibility.hpp>
+#include <algorithm>
+
+// Extrapolation is limited to one more interval past the newest palette so a stall does not fling the mesh away.
+#define MAX_EXTRAPOLATION 2.0f
+
+static glm::mat4 blend_transform(const glm::mat4& a, const glm::mat4& b, float t)
+{
+	glm::vec3 scale_a = glm::vec3(glm::length(glm::vec3(a[0])), glm::length(glm::vec3(a[1])), glm::length(glm::vec3(a[2])));
+	glm::vec3 scale_b = glm::vec3(glm::length(glm::vec3(b[0])), glm::length(glm::vec3(b[1])), glm::length(glm::vec3(b[2])));
+
+	glm::quat rotation_a = glm::quat_cast(glm::mat3(glm::vec3(a[0]) / scale_a.x, glm::vec3(a[1]) / scale_a.y, glm::vec3(a[2]) / scale_a.z));
+	glm::quat rotation_b = glm::quat_cast(glm::mat3(glm::vec3(b[0]) / scale_b.x, glm::vec3(b[1]) / scale_b.y, glm::vec3(b[2]) / scale_b.z));
+
+	glm::vec3 scale = glm::lerp(scale_a, scale_b, t);
+	glm::mat4 result = glm::mat4_cast(glm::normalize(glm::slerp(rotation_a, rotation_b, t)));
+
+	result[0] = result[0] * scale.x;
+	result[1] = result[1] * scale.y;
+	result[2] = result[2] * scale.z;
+	result[3] = glm::vec4(glm::lerp(glm::vec3(a[3]), glm::vec3(b[3]), t), 1.0f);
+
+	return result;
+}
+
+AnimUpdateLOD::AnimUpdateLOD(Skeleton* skeleton, uint32_t interval, uint32_t phase) : m_skeleton(skeleton), m_interval(std::max(interval, 1u)), m_phase(phase)
+{
+
+}
+
+AnimUpdateLOD::~AnimUpdateLOD()
+{
+
+}
+
+bool AnimUpdateLOD::update(double dt)
+{
+	m_elapsed += dt;
+
+	// Two evaluated palettes are needed before anything can be blended.
+	bool evaluate = m_interval == 1 || m_stored_count < 2 || (m_frame + m_phase) % m_interval == 0;
+
+	m_frame++;
+
+	return evaluate;
+}
+
+double AnimUpdateLOD::elapsed()
+{
+	return m_elapsed;
+}
+
+void AnimUpdateLOD::store(const PoseTransforms* palette)
+{
+	m_previous = m_last;
+	m_last = *palette;
+	m_gap = m_elapsed;
+	m_elapsed = 0.0;
+	m_stored_count = std::min(m_stored_count + 1, 2u);
+}
+
+PoseTransforms* AnimUpdateLOD::palette()
+{
+	if (m_interval == 1 || m_stored_count < 2 || m_gap <= 0.0)
+		return &m_last;
+
+	float t = static_cast<float>(m_elapsed / m_gap);
+
+	if (m_mode == UPDATE_LOD_EXTRAPOLATE)
+		t = std::min(t + 1.0f, MAX_EXTRAPOLATION);
+	else
+		t = std::min(t, 1.0f);
+
+	for (uint32_t i = 0; i < m_skeleton->num_bones(); i++)
+		m_palette.transforms[i] = blend_transform(m_previous.transforms[i], m_last.transforms[i], t);
+
+	return &m_palette;
+}
+
+void AnimUpdateLOD::set_interval(uint32_t interval)
+{
+	m_interval = std::max(interval, 1u);
+}
+
+uint32_t AnimUpdateLOD::interval()
+{
+	return m_interval;
+}
+
+void AnimUpdateLOD::set_phase(uint32_t phase)
+{
+	m_phase = phase;
+}
+
+uint32_t AnimUpdateLOD::phase()
+{
+	return m_phase;
+}
+
+void AnimUpdateLOD::set_mode(UpdateLODMode mode)
+{
+	m_mode = mode;
+}
+
+UpdateLODMode AnimUpdateLOD::mode()
+{
+	return m_mode;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "skeletal_mesh.h"
+
+enum UpdateLODMode
+{
+	// Skipped frames blend between the last two evaluated palettes. Smooth, but lags one update interval behind.
+	UPDATE_LOD_INTERPOLATE = 0,
+	// Skipped frames continue the motion between the last two evaluated palettes past the newest one. No lag, but
+	// overshoots on sudden changes.
+	UPDATE_LOD_EXTRAPOLATE
+};
+
+// Update-rate LOD for a single instance: the animation pipeline is only evaluated every 'interval' frames, and the
+// palette of the frames in between is built from the last two evaluated palettes. Instances given different phases
+// evaluate on different frames, spreading the cost of a crowd evenly.
+class AnimUpdateLOD
+{
+public:
+	AnimUpdateLOD(Skeleton* skeleton, uint32_t interval = 1, uint32_t phase = 0);
+	~AnimUpdateLOD();
+
+	// Advances the clock by 'dt' seconds. Returns true if the pipeline has to be evaluated this frame, in which case it
+	// should advance by elapsed() and hand its palette to store().
+	bool update(double dt);
+	double elapsed();
+	void store(const PoseTransforms* palette);
+
+	// Palette to render this frame, either the one just stored or a blend of the last two.
+	PoseTransforms* palette();
+
+	void set_interval(uint32_t interval);
+	uint32_t interval();
+	void set_phase(uint32_t phase);
+	uint32_t phase();
+	void set_mode(UpdateLODMode mode);
+	UpdateLODMode mode();
+
+private:
+	Skeleton*	   m_skeleton;
+	uint32_t	   m_interval;
+	uint32_t	   m_phase;
+	UpdateLODMode  m_mode = UPDATE_LOD_INTERPOLATE;
+	uint64_t	   m_frame = 0;
+	uint32_t	   m_stored_count = 0;
+	double		   m_elapsed = 0.0; // Since the last evaluation.
+	double		   m_gap = 0.0; // Between the last two evaluations.
+	PoseTransforms m_previous;
+	PoseTransforms m_last;
+	PoseTransforms m_palette;
+};
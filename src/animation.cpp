@@ -4,6 +4,17 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 #include "skeleton.h"
+#include "keyframe_reduction.h"
+#include "binary_io.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <gtx/compatibility.hpp>
+
+#define QUANTIZED_VALUE_MAX 65535.0f
+#define QUANTIZED_COMPONENT_MAX 32767.0f
+#define SMALLEST_THREE_RANGE 0.70710678f // 1 / sqrt(2), the largest value any of the three smallest components can take.
 
 glm::vec3 translation_delta(const glm::vec3& reference, glm::vec3 additive)
 {
@@ -20,7 +31,389 @@ glm::quat rotation_delta(const glm::quat& reference, glm::quat additive)
 	return glm::conjugate(reference) * additive;
 }
 
-Animation* Animation::load(const std::string& name, Skeleton* skeleton, bool additive, Animation* additive_reference)
+Keyframe compose_keyframe(const Keyframe& parent, const Keyframe& local)
+{
+	Keyframe result;
+
+	result.translation = parent.translation + parent.rotation * local.translation;
+	result.rotation = parent.rotation * local.rotation;
+	result.scale = glm::vec3(1.0f);
+
+	return result;
+}
+
+glm::mat4 keyframe_matrix(const Keyframe& keyframe)
+{
+	glm::mat4 result = glm::mat4_cast(keyframe.rotation);
+
+	result[3] = glm::vec4(keyframe.translation, 1.0f);
+
+	return result;
+}
+
+void pack_transforms(const PoseTransforms* transforms, uint32_t count, CompactPoseTransforms* output)
+{
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const glm::mat4& m = transforms->transforms[i];
+
+		for (uint32_t r = 0; r < 3; r++)
+			output->transforms[i].rows[r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+	}
+
+	output->num_transforms = count;
+}
+
+void unpack_transforms(const CompactPoseTransforms* transforms, PoseTransforms* output)
+{
+	for (uint32_t i = 0; i < transforms->num_transforms; i++)
+	{
+		glm::mat4& m = output->transforms[i];
+
+		for (uint32_t c = 0; c < 4; c++)
+		{
+			for (uint32_t r = 0; r < 3; r++)
+				m[c][r] = transforms->transforms[i].rows[r][c];
+
+			m[c][3] = c == 3 ? 1.0f : 0.0f;
+		}
+	}
+}
+
+static uint16_t quantize_time(double time, double duration_in_ticks)
+{
+	if (duration_in_ticks <= 0.0)
+		return 0;
+
+	double normalized = std::min(std::max(time / duration_in_ticks, 0.0), 1.0);
+
+	return static_cast<uint16_t>(std::round(normalized * QUANTIZED_TIME_MAX));
+}
+
+static uint16_t quantize_float(float value, float min, float extent)
+{
+	if (extent <= 0.0f)
+		return 0;
+
+	float normalized = std::min(std::max((value - min) / extent, 0.0f), 1.0f);
+
+	return static_cast<uint16_t>(std::round(normalized * QUANTIZED_VALUE_MAX));
+}
+
+static void encode_vector(CompressedTrack& track, const glm::vec3& value)
+{
+	for (int i = 0; i < 3; i++)
+		track.values.push_back(quantize_float(value[i], track.range_min[i], track.range_extent[i]));
+}
+
+// Smallest-three packing: the largest component is dropped and the remaining three are stored in 15 bits each.
+// The index of the dropped component goes into the top bits of the first two values.
+static void encode_rotation(CompressedTrack& track, glm::quat rotation)
+{
+	rotation = glm::normalize(rotation);
+
+	float components[4] = { rotation.x, rotation.y, rotation.z, rotation.w };
+	uint32_t largest = 0;
+
+	for (uint32_t i = 1; i < 4; i++)
+	{
+		if (fabsf(components[i]) > fabsf(components[largest]))
+			largest = i;
+	}
+
+	// q and -q are the same rotation, so flip the quaternion to make the dropped component positive.
+	float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+
+		float normalized = std::min(std::max((components[i] * sign) / (2.0f * SMALLEST_THREE_RANGE) + 0.5f, 0.0f), 1.0f);
+		uint16_t value = static_cast<uint16_t>(std::round(normalized * QUANTIZED_COMPONENT_MAX));
+
+		if (count < 2)
+			value |= ((largest >> count) & 1) << 15;
+
+		track.values.push_back(value);
+		count++;
+	}
+}
+
+glm::vec3 decode_vector(const CompressedTrack& track, uint32_t idx)
+{
+	const uint16_t* values = &track.values[idx * 3];
+
+	return glm::vec3(track.range_min.x + track.range_extent.x * (values[0] / QUANTIZED_VALUE_MAX),
+					 track.range_min.y + track.range_extent.y * (values[1] / QUANTIZED_VALUE_MAX),
+					 track.range_min.z + track.range_extent.z * (values[2] / QUANTIZED_VALUE_MAX));
+}
+
+glm::quat decode_rotation(const CompressedTrack& track, uint32_t idx)
+{
+	const uint16_t* values = &track.values[idx * 3];
+
+	uint32_t largest = ((values[0] >> 15) & 1) | (((values[1] >> 15) & 1) << 1);
+	float components[4];
+	float sum = 0.0f;
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+
+		float normalized = (values[count] & 0x7FFF) / QUANTIZED_COMPONENT_MAX;
+		components[i] = (normalized - 0.5f) * 2.0f * SMALLEST_THREE_RANGE;
+		sum += components[i] * components[i];
+		count++;
+	}
+
+	components[largest] = sqrtf(std::max(1.0f - sum, 0.0f));
+
+	return glm::normalize(glm::quat(components[3], components[0], components[1], components[2]));
+}
+
+template <typename T>
+static void compute_range(const std::vector<T>& keys, glm::vec3 T::*member, CompressedTrack& track)
+{
+	track.range_min = glm::vec3(0.0f);
+	track.range_extent = glm::vec3(0.0f);
+
+	if (keys.size() == 0)
+		return;
+
+	glm::vec3 min = keys[0].*member;
+	glm::vec3 max = keys[0].*member;
+
+	for (const auto& key : keys)
+	{
+		min = glm::min(min, key.*member);
+		max = glm::max(max, key.*member);
+	}
+
+	track.range_min = min;
+	track.range_extent = max - min;
+}
+
+void write_key_stream(float* streams, uint32_t stride, uint32_t idx, const Keyframe& keyframe)
+{
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		streams[(KEY_STREAM_TRANSLATION_X + i) * stride + idx] = keyframe.translation[i];
+		streams[(KEY_STREAM_SCALE_X + i) * stride + idx] = keyframe.scale[i];
+	}
+
+	streams[KEY_STREAM_ROTATION_X * stride + idx] = keyframe.rotation.x;
+	streams[KEY_STREAM_ROTATION_Y * stride + idx] = keyframe.rotation.y;
+	streams[KEY_STREAM_ROTATION_Z * stride + idx] = keyframe.rotation.z;
+	streams[KEY_STREAM_ROTATION_W * stride + idx] = keyframe.rotation.w;
+}
+
+glm::quat read_key_stream_rotation(const float* streams, uint32_t stride, uint32_t idx)
+{
+	return glm::quat(streams[KEY_STREAM_ROTATION_W * stride + idx],
+					 streams[KEY_STREAM_ROTATION_X * stride + idx],
+					 streams[KEY_STREAM_ROTATION_Y * stride + idx],
+					 streams[KEY_STREAM_ROTATION_Z * stride + idx]);
+}
+
+Keyframe read_key_stream(const float* streams, uint32_t stride, uint32_t idx)
+{
+	Keyframe keyframe;
+
+	keyframe.translation = glm::vec3(streams[KEY_STREAM_TRANSLATION_X * stride + idx], streams[KEY_STREAM_TRANSLATION_Y * stride + idx], streams[KEY_STREAM_TRANSLATION_Z * stride + idx]);
+	keyframe.rotation = read_key_stream_rotation(streams, stride, idx);
+	keyframe.scale = glm::vec3(streams[KEY_STREAM_SCALE_X * stride + idx], streams[KEY_STREAM_SCALE_Y * stride + idx], streams[KEY_STREAM_SCALE_Z * stride + idx]);
+
+	return keyframe;
+}
+
+// Returns the key preceding 'ticks', clamped so that the key after it always exists.
+template <typename T>
+uint32_t find_key_index(const std::vector<T>& keys, double ticks)
+{
+	auto it = std::upper_bound(keys.begin(), keys.end(), ticks, [](double t, const T& key) { return t < key.time; });
+	uint32_t idx = it == keys.begin() ? 0 : static_cast<uint32_t>(it - keys.begin()) - 1;
+
+	return std::min(idx, static_cast<uint32_t>(keys.size()) - 2);
+}
+
+template <typename T>
+float key_factor(const std::vector<T>& keys, uint32_t idx, double ticks)
+{
+	double delta = keys[idx + 1].time - keys[idx].time;
+
+	if (delta <= 0.0)
+		return 0.0f;
+
+	return static_cast<float>(std::min(std::max((ticks - keys[idx].time) / delta, 0.0), 1.0));
+}
+
+Keyframe evaluate_channel(const AnimationChannel& channel, double ticks)
+{
+	Keyframe result;
+
+	if (channel.translation_keyframes.size() == 0)
+		result.translation = glm::vec3(0.0f);
+	else if (channel.translation_keyframes.size() == 1)
+		result.translation = channel.translation_keyframes[0].translation;
+	else
+	{
+		uint32_t idx = find_key_index(channel.translation_keyframes, ticks);
+		result.translation = glm::lerp(channel.translation_keyframes[idx].translation, channel.translation_keyframes[idx + 1].translation, key_factor(channel.translation_keyframes, idx, ticks));
+	}
+
+	if (channel.rotation_keyframes.size() == 0)
+		result.rotation = glm::quat();
+	else if (channel.rotation_keyframes.size() == 1)
+		result.rotation = channel.rotation_keyframes[0].rotation;
+	else
+	{
+		uint32_t idx = find_key_index(channel.rotation_keyframes, ticks);
+		result.rotation = glm::slerp(channel.rotation_keyframes[idx].rotation, channel.rotation_keyframes[idx + 1].rotation, key_factor(channel.rotation_keyframes, idx, ticks));
+	}
+
+	if (channel.scale_keyframes.size() == 0)
+		result.scale = glm::vec3(1.0f);
+	else if (channel.scale_keyframes.size() == 1)
+		result.scale = channel.scale_keyframes[0].scale;
+	else
+	{
+		uint32_t idx = find_key_index(channel.scale_keyframes, ticks);
+		result.scale = glm::lerp(channel.scale_keyframes[idx].scale, channel.scale_keyframes[idx + 1].scale, key_factor(channel.scale_keyframes, idx, ticks));
+	}
+
+	return result;
+}
+
+void find_channel_keys(const AnimationChannel& channel, double ticks, KeyCursor& cursor, Keyframe& key_1, Keyframe& key_2, float* factors)
+{
+	// Find translation keys
+	{
+		if (channel.translation_keyframes.size() == 0)
+		{
+			key_1.translation = key_2.translation = glm::vec3(0.0f);
+			factors[0] = 0.0f;
+		}
+		else if (channel.translation_keyframes.size() == 1)
+		{
+			key_1.translation = key_2.translation = channel.translation_keyframes[0].translation;
+			factors[0] = 0.0f;
+		}
+		else
+		{
+			const uint32_t idx_1 = find_key(channel.translation_keyframes, ticks, cursor.translation);
+			const uint32_t idx_2 = idx_1 + 1;
+
+			float delta = (float)(channel.translation_keyframes[idx_2].time - channel.translation_keyframes[idx_1].time);
+			factors[0] = (ticks - (float)channel.translation_keyframes[idx_1].time) / delta;
+
+			key_1.translation = channel.translation_keyframes[idx_1].translation;
+			key_2.translation = channel.translation_keyframes[idx_2].translation;
+		}
+	}
+
+	// Find rotation keys
+	{
+		if (channel.rotation_keyframes.size() == 0)
+		{
+			key_1.rotation = key_2.rotation = glm::quat();
+			factors[1] = 0.0f;
+		}
+		else if (channel.rotation_keyframes.size() == 1)
+		{
+			key_1.rotation = key_2.rotation = channel.rotation_keyframes[0].rotation;
+			factors[1] = 0.0f;
+		}
+		else
+		{
+			const uint32_t idx_1 = find_key(channel.rotation_keyframes, ticks, cursor.rotation);
+			const uint32_t idx_2 = idx_1 + 1;
+
+			float delta = (float)(channel.rotation_keyframes[idx_2].time - channel.rotation_keyframes[idx_1].time);
+			factors[1] = (ticks - (float)channel.rotation_keyframes[idx_1].time) / delta;
+
+			key_1.rotation = channel.rotation_keyframes[idx_1].rotation;
+			key_2.rotation = channel.rotation_keyframes[idx_2].rotation;
+		}
+	}
+
+	// Find scale keys
+	{
+		if (channel.scale_keyframes.size() == 0)
+		{
+			key_1.scale = key_2.scale = glm::vec3(1.0f);
+			factors[2] = 0.0f;
+		}
+		else if (channel.scale_keyframes.size() == 1)
+		{
+			key_1.scale = key_2.scale = channel.scale_keyframes[0].scale;
+			factors[2] = 0.0f;
+		}
+		else
+		{
+			const uint32_t idx_1 = find_key(channel.scale_keyframes, ticks, cursor.scale);
+			const uint32_t idx_2 = idx_1 + 1;
+
+			float delta = (float)(channel.scale_keyframes[idx_2].time - channel.scale_keyframes[idx_1].time);
+			factors[2] = (ticks - (float)channel.scale_keyframes[idx_1].time) / delta;
+
+			key_1.scale = channel.scale_keyframes[idx_1].scale;
+			key_2.scale = channel.scale_keyframes[idx_2].scale;
+		}
+	}
+}
+
+void find_compressed_channel_keys(const CompressedChannel& channel, double quantized_time, KeyCursor& cursor, Keyframe& key_1, Keyframe& key_2, float* factors)
+{
+	const CompressedTrack* tracks[] = { &channel.translation, &channel.rotation, &channel.scale };
+	uint32_t* cursors[] = { &cursor.translation, &cursor.rotation, &cursor.scale };
+	uint32_t idx[3][2] = { { 0, 0 }, { 0, 0 }, { 0, 0 } };
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		const CompressedTrack& track = *tracks[i];
+
+		factors[i] = 0.0f;
+
+		if (track.times.size() > 1)
+		{
+			idx[i][0] = find_key(track.times, quantized_time, *cursors[i]);
+			idx[i][1] = idx[i][0] + 1;
+
+			float delta = (float)(track.times[idx[i][1]] - track.times[idx[i][0]]);
+			factors[i] = delta > 0.0f ? (float)(quantized_time - track.times[idx[i][0]]) / delta : 0.0f;
+		}
+	}
+
+	if (channel.translation.times.size() == 0)
+		key_1.translation = key_2.translation = glm::vec3(0.0f);
+	else
+	{
+		key_1.translation = decode_vector(channel.translation, idx[0][0]);
+		key_2.translation = decode_vector(channel.translation, idx[0][1]);
+	}
+
+	if (channel.rotation.times.size() == 0)
+		key_1.rotation = key_2.rotation = glm::quat();
+	else
+	{
+		key_1.rotation = decode_rotation(channel.rotation, idx[1][0]);
+		key_2.rotation = decode_rotation(channel.rotation, idx[1][1]);
+	}
+
+	if (channel.scale.times.size() == 0)
+		key_1.scale = key_2.scale = glm::vec3(1.0f);
+	else
+	{
+		key_1.scale = decode_vector(channel.scale, idx[2][0]);
+		key_2.scale = decode_vector(channel.scale, idx[2][1]);
+	}
+}
+
+Animation* Animation::load(const std::string& name, Skeleton* skeleton, bool additive, Animation* additive_reference, float sample_rate, const KeyReductionSettings* reduction)
 {
 	const aiScene* scene;
 	Assimp::Importer importer;
@@ -68,12 +461,7 @@ Animation* Animation::load(const std::string& name, Skeleton* skeleton, bool add
 			if (channel->mNumPositionKeys > 0)
 			{
 				if (additive_reference)
-				{
-					AnimationChannel& additive_channel = additive_reference->channels[joint_index];
-
-					if (additive_channel.translation_keyframes.size() > 0)
-						reference_translation = additive_channel.translation_keyframes[0].translation;
-				}
+					reference_translation = additive_reference->first_keyframe(joint_index).translation;
 				else
 					reference_translation = glm::vec3(channel->mPositionKeys[0].mValue.x, channel->mPositionKeys[0].mValue.y, channel->mPositionKeys[0].mValue.z);
 			}
@@ -99,12 +487,7 @@ Animation* Animation::load(const std::string& name, Skeleton* skeleton, bool add
 			if (channel->mNumRotationKeys > 0)
 			{
 				if (additive_reference)
-				{
-					AnimationChannel& additive_channel = additive_reference->channels[joint_index];
-
-					if (additive_channel.rotation_keyframes.size() > 0)
-						reference_rotation = additive_channel.rotation_keyframes[0].rotation;
-				}
+					reference_rotation = additive_reference->first_keyframe(joint_index).rotation;
 				else
 				{
 					reference_rotation = glm::quat(channel->mRotationKeys[0].mValue.w,
@@ -135,12 +518,7 @@ Animation* Animation::load(const std::string& name, Skeleton* skeleton, bool add
 			if (channel->mNumScalingKeys > 0)
 			{
 				if (additive_reference)
-				{
-					AnimationChannel& additive_channel = additive_reference->channels[joint_index];
-
-					if (additive_channel.scale_keyframes.size() > 0)
-						reference_scale = additive_channel.scale_keyframes[0].scale;
-				}
+					reference_scale = additive_reference->first_keyframe(joint_index).scale;
 				else
 					reference_scale = glm::vec3(channel->mScalingKeys[0].mValue.x, channel->mScalingKeys[0].mValue.y, channel->mScalingKeys[0].mValue.z);
 			}
@@ -159,9 +537,578 @@ Animation* Animation::load(const std::string& name, Skeleton* skeleton, bool add
 		}
 	}
 
+	output_animation->strip_constant_tracks();
+
+	if (reduction)
+		reduce_keyframes(output_animation, skeleton, *reduction);
+
+	if (sample_rate > 0.0f)
+		output_animation->resample(sample_rate);
+
 	return output_animation;
 }
 
+static void write_track(std::ofstream& stream, const CompressedTrack& track)
+{
+	write_value(stream, track.range_min);
+	write_value(stream, track.range_extent);
+	write_vector(stream, track.times);
+	write_vector(stream, track.values);
+}
+
+static bool read_track(std::ifstream& stream, CompressedTrack& track)
+{
+	read_value(stream, track.range_min);
+	read_value(stream, track.range_extent);
+	read_vector(stream, track.times);
+	read_vector(stream, track.values);
+
+	// Every key holds three quantized values, see decode_vector() and decode_rotation().
+	return stream.good() && track.values.size() == track.times.size() * 3 && std::is_sorted(track.times.begin(), track.times.end());
+}
+
+// Flags are written as a one byte bool. Any value other than 0 or 1 means the file is corrupt.
+static bool read_flag(std::ifstream& stream, bool& value)
+{
+	uint8_t flag = 0;
+
+	if (!read_value(stream, flag) || flag > 1)
+		return false;
+
+	value = flag == 1;
+	return true;
+}
+
+// find_key() searches forward from a cursor, so key times must never decrease. Also rejects NaN times.
+template <typename T>
+static bool key_times_sorted(const std::vector<T>& keys)
+{
+	for (uint32_t i = 1; i < keys.size(); i++)
+	{
+		if (!(keys[i - 1].time <= keys[i].time))
+			return false;
+	}
+
+	return true;
+}
+
+Animation* Animation::load_baked(const std::string& path, Skeleton* skeleton)
+{
+	std::ifstream stream(path, std::ios::in | std::ios::binary);
+
+	if (!stream.is_open())
+		return nullptr;
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	uint64_t skeleton_hash = 0;
+
+	if (!read_value(stream, magic) || !read_value(stream, version) || magic != BAKED_ANIMATION_MAGIC || version != BAKED_ANIMATION_VERSION)
+	{
+		DW_LOG_ERROR("Unsupported baked animation : " + path);
+		return nullptr;
+	}
+
+	if (!read_value(stream, skeleton_hash) || skeleton_hash != skeleton->hash())
+	{
+		DW_LOG_ERROR("Baked animation does not match skeleton : " + path);
+		return nullptr;
+	}
+
+	Animation* animation = new Animation();
+
+	read_string(stream, animation->name);
+	read_value(stream, animation->keyframe_count);
+	read_value(stream, animation->duration);
+	read_value(stream, animation->duration_in_ticks);
+	read_value(stream, animation->ticks_per_second);
+
+	// Samplers index channels by joint, so a clip must hold exactly one channel per joint of the skeleton.
+	uint32_t channel_count = 0;
+
+	if (!read_value(stream, channel_count) || channel_count != skeleton->num_bones() || channel_count > MAX_BONES)
+	{
+		DW_LOG_ERROR("Baked animation channel count does not match skeleton : " + path);
+		delete animation;
+		return nullptr;
+	}
+
+	animation->channels.resize(channel_count);
+
+	for (auto& channel : animation->channels)
+	{
+		read_string(stream, channel.joint_name);
+		read_vector(stream, channel.translation_keyframes);
+		read_vector(stream, channel.rotation_keyframes);
+		read_vector(stream, channel.scale_keyframes);
+	}
+
+	if (!stream.good())
+	{
+		DW_LOG_ERROR("Failed to read channels of baked animation : " + path);
+		delete animation;
+		return nullptr;
+	}
+
+	for (const auto& channel : animation->channels)
+	{
+		if (!key_times_sorted(channel.translation_keyframes) || !key_times_sorted(channel.rotation_keyframes) || !key_times_sorted(channel.scale_keyframes))
+		{
+			DW_LOG_ERROR("Unsorted key times in baked animation : " + path);
+			delete animation;
+			return nullptr;
+		}
+	}
+
+	if (!read_flag(stream, animation->compressed))
+	{
+		DW_LOG_ERROR("Corrupt compression flag in baked animation : " + path);
+		delete animation;
+		return nullptr;
+	}
+
+	if (animation->compressed)
+	{
+		if (!read_value(stream, channel_count) || channel_count != animation->channels.size())
+		{
+			DW_LOG_ERROR("Baked animation compressed channel count does not match skeleton : " + path);
+			delete animation;
+			return nullptr;
+		}
+
+		animation->compressed_channels.resize(channel_count);
+
+		for (auto& channel : animation->compressed_channels)
+		{
+			if (!read_track(stream, channel.translation) || !read_track(stream, channel.rotation) || !read_track(stream, channel.scale))
+			{
+				DW_LOG_ERROR("Corrupt or unsorted compressed track in baked animation : " + path);
+				delete animation;
+				return nullptr;
+			}
+		}
+	}
+
+	if (!read_flag(stream, animation->resampled))
+	{
+		DW_LOG_ERROR("Corrupt resampling flag in baked animation : " + path);
+		delete animation;
+		return nullptr;
+	}
+
+	if (animation->resampled)
+	{
+		read_value(stream, animation->sample_rate);
+		read_value(stream, animation->frame_count);
+		read_value(stream, animation->frame_stride);
+		read_vector(stream, animation->frames);
+
+		uint32_t frame_stride = ((channel_count + KEY_STREAM_ALIGNMENT - 1) / KEY_STREAM_ALIGNMENT) * KEY_STREAM_ALIGNMENT;
+
+		if (animation->frame_count < 2 || animation->frame_stride != frame_stride || animation->frames.size() != uint64_t(animation->frame_count) * KEY_STREAM_COUNT * frame_stride)
+		{
+			DW_LOG_ERROR("Baked animation frame data does not match its frame count : " + path);
+			delete animation;
+			return nullptr;
+		}
+	}
+
+	animation->find_animated_joints();
+
+	if (!stream.good())
+	{
+		DW_LOG_ERROR("Failed to read baked animation : " + path);
+		delete animation;
+		return nullptr;
+	}
+
+	return animation;
+}
+
+bool Animation::save(const std::string& path, Skeleton* skeleton)
+{
+	std::ofstream stream(path, std::ios::out | std::ios::binary);
+
+	if (!stream.is_open())
+	{
+		DW_LOG_ERROR("Failed to open file for writing : " + path);
+		return false;
+	}
+
+	write_value(stream, (uint32_t)BAKED_ANIMATION_MAGIC);
+	write_value(stream, (uint32_t)BAKED_ANIMATION_VERSION);
+	write_value(stream, skeleton->hash());
+
+	write_string(stream, name);
+	write_value(stream, keyframe_count);
+	write_value(stream, duration);
+	write_value(stream, duration_in_ticks);
+	write_value(stream, ticks_per_second);
+
+	write_value(stream, (uint32_t)channels.size());
+
+	for (const auto& channel : channels)
+	{
+		write_string(stream, channel.joint_name);
+		write_vector(stream, channel.translation_keyframes);
+		write_vector(stream, channel.rotation_keyframes);
+		write_vector(stream, channel.scale_keyframes);
+	}
+
+	write_value(stream, compressed);
+
+	if (compressed)
+	{
+		write_value(stream, (uint32_t)compressed_channels.size());
+
+		for (const auto& channel : compressed_channels)
+		{
+			write_track(stream, channel.translation);
+			write_track(stream, channel.rotation);
+			write_track(stream, channel.scale);
+		}
+	}
+
+	write_value(stream, resampled);
+
+	if (resampled)
+	{
+		write_value(stream, sample_rate);
+		write_value(stream, frame_count);
+		write_value(stream, frame_stride);
+		write_vector(stream, frames);
+	}
+
+	return stream.good();
+}
+
+uint32_t resampled_frame(double ticks, double ticks_per_second, float sample_rate, double duration_in_ticks, uint32_t frame_count, float& factor)
+{
+	double frames_per_tick = sample_rate / ticks_per_second;
+	double frame_position = ticks * frames_per_tick;
+	uint32_t frame = std::min(static_cast<uint32_t>(frame_position), frame_count - 2);
+
+	// Length of the gap to the next frame, in frames.
+	double gap = frame == frame_count - 2 ? duration_in_ticks * frames_per_tick - frame : 1.0;
+
+	factor = gap > 0.0 ? static_cast<float>(std::min((frame_position - frame) / gap, 1.0)) : 0.0f;
+
+	return frame;
+}
+
+void Animation::resample(float rate)
+{
+	if (rate <= 0.0f)
+		return;
+
+	if (resampled || compressed)
+	{
+		DW_LOG_ERROR("Animation can only be resampled once, before compression : " + name);
+		return;
+	}
+
+	double ticks_per_frame = (ticks_per_second != 0.0 ? ticks_per_second : 25.0) / rate;
+	uint32_t num_channels = channels.size();
+
+	// One extra frame so that the last frame lands exactly on the end of the clip, and always at least two to interpolate between.
+	frame_count = std::max(static_cast<uint32_t>(std::ceil(duration_in_ticks / ticks_per_frame)) + 1, 2u);
+	frame_stride = ((num_channels + KEY_STREAM_ALIGNMENT - 1) / KEY_STREAM_ALIGNMENT) * KEY_STREAM_ALIGNMENT;
+	frames.resize(frame_count * KEY_STREAM_COUNT * frame_stride);
+
+	Keyframe identity;
+
+	identity.translation = glm::vec3(0.0f);
+	identity.rotation = glm::quat();
+	identity.scale = glm::vec3(1.0f);
+
+	for (uint32_t i = 0; i < frame_count; i++)
+	{
+		double ticks = std::min(i * ticks_per_frame, duration_in_ticks);
+		float* streams = &frames[i * KEY_STREAM_COUNT * frame_stride];
+
+		for (uint32_t j = 0; j < frame_stride; j++)
+			write_key_stream(streams, frame_stride, j, j < num_channels ? evaluate_channel(channels[j], ticks) : identity);
+	}
+
+	for (auto& channel : channels)
+	{
+		std::vector<TranslationKey>().swap(channel.translation_keyframes);
+		std::vector<RotationKey>().swap(channel.rotation_keyframes);
+		std::vector<ScaleKey>().swap(channel.scale_keyframes);
+	}
+
+	sample_rate = rate;
+	resampled = true;
+}
+
+static bool track_value_equal(const glm::vec3& a, const glm::vec3& b, float tolerance)
+{
+	glm::vec3 delta = glm::abs(a - b);
+	return std::max(delta.x, std::max(delta.y, delta.z)) <= tolerance;
+}
+
+static bool track_value_equal(const glm::quat& a, const glm::quat& b, float tolerance)
+{
+	// Angle between the rotations, from the chord between the quaternions since acos() of their dot product has no
+	// resolution close to one. q and -q are the same rotation.
+	glm::quat d = glm::dot(a, b) < 0.0f ? a + b : a - b;
+	double	  chord = std::sqrt((double)d.x * d.x + (double)d.y * d.y + (double)d.z * d.z + (double)d.w * d.w);
+	return 4.0 * std::asin(std::min(chord * 0.5, 1.0)) <= tolerance;
+}
+
+template <typename T, typename V, typename F>
+static bool strip_constant_track(std::vector<T>& keys, F value, const V& missing, float tolerance)
+{
+	if (keys.size() == 0)
+		return false;
+
+	for (const auto& key : keys)
+	{
+		if (!track_value_equal(value(key), value(keys[0]), tolerance))
+			return false;
+	}
+
+	if (track_value_equal(value(keys[0]), missing, tolerance))
+		keys.clear();
+	else
+		keys.resize(1);
+
+	keys.shrink_to_fit();
+
+	return true;
+}
+
+void Animation::strip_constant_tracks(float tolerance)
+{
+	if (resampled || compressed)
+	{
+		DW_LOG_ERROR("Constant tracks can only be stripped from the source keys : " + name);
+		return;
+	}
+
+	uint32_t stripped_tracks = 0;
+
+	for (auto& channel : channels)
+	{
+		stripped_tracks += strip_constant_track(channel.translation_keyframes, [](const TranslationKey& key) { return key.translation; }, glm::vec3(0.0f), tolerance);
+		stripped_tracks += strip_constant_track(channel.rotation_keyframes, [](const RotationKey& key) { return key.rotation; }, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), tolerance);
+		stripped_tracks += strip_constant_track(channel.scale_keyframes, [](const ScaleKey& key) { return key.scale; }, glm::vec3(1.0f), tolerance);
+	}
+
+	find_animated_joints();
+
+	DW_LOG_INFO("Stripped " + std::to_string(stripped_tracks) + " constant tracks from animation " + name + ", " + std::to_string(animated_joints.size()) + " of " + std::to_string(channels.size()) + " joints animated");
+}
+
+void Animation::find_animated_joints()
+{
+	animated_joints.clear();
+
+	if (resampled)
+	{
+		// Every joint is stored in every frame, compare the values against the first frame instead.
+		uint32_t frame_size = KEY_STREAM_COUNT * frame_stride;
+
+		for (uint32_t i = 0; i < frame_stride; i++)
+		{
+			for (uint32_t j = 1; j < frame_count; j++)
+			{
+				bool changed = false;
+
+				for (uint32_t k = 0; k < KEY_STREAM_COUNT; k++)
+					changed |= frames[j * frame_size + k * frame_stride + i] != frames[k * frame_stride + i];
+
+				if (changed)
+				{
+					animated_joints.push_back(i);
+					break;
+				}
+			}
+		}
+	}
+	else if (compressed)
+	{
+		for (uint32_t i = 0; i < compressed_channels.size(); i++)
+		{
+			const CompressedChannel& channel = compressed_channels[i];
+
+			if (channel.translation.times.size() > 1 || channel.rotation.times.size() > 1 || channel.scale.times.size() > 1)
+				animated_joints.push_back(i);
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < channels.size(); i++)
+		{
+			const AnimationChannel& channel = channels[i];
+
+			if (channel.translation_keyframes.size() > 1 || channel.rotation_keyframes.size() > 1 || channel.scale_keyframes.size() > 1)
+				animated_joints.push_back(i);
+		}
+	}
+}
+
+void merge_additive_joints(Animation* animation, std::vector<uint32_t>& joints)
+{
+	std::vector<uint32_t> additive_joints;
+	uint32_t			  next_animated = 0;
+	uint32_t			  num_joints = animation->resampled ? animation->frame_stride : std::max(animation->channels.size(), animation->compressed_channels.size());
+
+	for (uint32_t i = 0; i < num_joints; i++)
+	{
+		if (next_animated < animation->animated_joints.size() && animation->animated_joints[next_animated] == i)
+		{
+			additive_joints.push_back(i);
+			next_animated++;
+			continue;
+		}
+
+		Keyframe key = animation->first_keyframe(i);
+
+		if (!track_value_equal(key.translation, glm::vec3(0.0f), CONSTANT_TRACK_TOLERANCE) ||
+			!track_value_equal(key.rotation, glm::quat(1.0f, 0.0f, 0.0f, 0.0f), CONSTANT_TRACK_TOLERANCE) ||
+			!track_value_equal(key.scale, glm::vec3(1.0f), CONSTANT_TRACK_TOLERANCE))
+			additive_joints.push_back(i);
+	}
+
+	std::vector<uint32_t> merged;
+
+	std::set_union(joints.begin(), joints.end(), additive_joints.begin(), additive_joints.end(), std::back_inserter(merged));
+	joints.swap(merged);
+}
+
+Keyframe Animation::first_keyframe(uint32_t joint_index)
+{
+	if (resampled)
+		return read_key_stream(frame(0), frame_stride, joint_index);
+
+	Keyframe result;
+
+	result.translation = glm::vec3(0.0f);
+	result.rotation = glm::quat();
+	result.scale = glm::vec3(1.0f);
+
+	if (compressed)
+	{
+		const CompressedChannel& channel = compressed_channels[joint_index];
+
+		if (channel.translation.times.size() > 0)
+			result.translation = decode_vector(channel.translation, 0);
+
+		if (channel.rotation.times.size() > 0)
+			result.rotation = decode_rotation(channel.rotation, 0);
+
+		if (channel.scale.times.size() > 0)
+			result.scale = decode_vector(channel.scale, 0);
+	}
+	else
+	{
+		const AnimationChannel& channel = channels[joint_index];
+
+		if (channel.translation_keyframes.size() > 0)
+			result.translation = channel.translation_keyframes[0].translation;
+
+		if (channel.rotation_keyframes.size() > 0)
+			result.rotation = channel.rotation_keyframes[0].rotation;
+
+		if (channel.scale_keyframes.size() > 0)
+			result.scale = channel.scale_keyframes[0].scale;
+	}
+
+	return result;
+}
+
+CompressionReport Animation::compress(bool keep_source)
+{
+	CompressionReport report;
+
+	report.source_bytes = 0;
+	report.compressed_bytes = 0;
+	report.max_translation_error = 0.0f;
+	report.max_rotation_error = 0.0f;
+	report.max_scale_error = 0.0f;
+
+	if (resampled)
+	{
+		DW_LOG_ERROR("Resampled animations can not be compressed : " + name);
+		return report;
+	}
+
+	compressed_channels.resize(channels.size());
+
+	for (uint32_t i = 0; i < channels.size(); i++)
+	{
+		const AnimationChannel& channel = channels[i];
+		CompressedChannel& compressed_channel = compressed_channels[i];
+
+		// Translation Keyframes
+		compute_range(channel.translation_keyframes, &TranslationKey::translation, compressed_channel.translation);
+
+		for (const auto& key : channel.translation_keyframes)
+		{
+			compressed_channel.translation.times.push_back(quantize_time(key.time, duration_in_ticks));
+			encode_vector(compressed_channel.translation, key.translation);
+		}
+
+		// Rotation Keyframes
+		compressed_channel.rotation.range_min = glm::vec3(0.0f);
+		compressed_channel.rotation.range_extent = glm::vec3(0.0f);
+
+		for (const auto& key : channel.rotation_keyframes)
+		{
+			compressed_channel.rotation.times.push_back(quantize_time(key.time, duration_in_ticks));
+			encode_rotation(compressed_channel.rotation, key.rotation);
+		}
+
+		// Scale Keyframes
+		compute_range(channel.scale_keyframes, &ScaleKey::scale, compressed_channel.scale);
+
+		for (const auto& key : channel.scale_keyframes)
+		{
+			compressed_channel.scale.times.push_back(quantize_time(key.time, duration_in_ticks));
+			encode_vector(compressed_channel.scale, key.scale);
+		}
+
+		// Measure the error introduced by quantization against the source keys.
+		for (uint32_t j = 0; j < channel.translation_keyframes.size(); j++)
+			report.max_translation_error = std::max(report.max_translation_error, glm::length(decode_vector(compressed_channel.translation, j) - channel.translation_keyframes[j].translation));
+
+		for (uint32_t j = 0; j < channel.rotation_keyframes.size(); j++)
+		{
+			float d = fabsf(glm::dot(decode_rotation(compressed_channel.rotation, j), glm::normalize(channel.rotation_keyframes[j].rotation)));
+			report.max_rotation_error = std::max(report.max_rotation_error, 2.0f * acosf(std::min(d, 1.0f)));
+		}
+
+		for (uint32_t j = 0; j < channel.scale_keyframes.size(); j++)
+			report.max_scale_error = std::max(report.max_scale_error, glm::length(decode_vector(compressed_channel.scale, j) - channel.scale_keyframes[j].scale));
+
+		report.source_bytes += sizeof(TranslationKey) * channel.translation_keyframes.size();
+		report.source_bytes += sizeof(RotationKey) * channel.rotation_keyframes.size();
+		report.source_bytes += sizeof(ScaleKey) * channel.scale_keyframes.size();
+
+		const CompressedTrack* tracks[] = { &compressed_channel.translation, &compressed_channel.rotation, &compressed_channel.scale };
+
+		for (const CompressedTrack* track : tracks)
+			report.compressed_bytes += sizeof(glm::vec3) * 2 + sizeof(uint16_t) * (track->times.size() + track->values.size());
+	}
+
+	compressed = true;
+
+	if (!keep_source)
+	{
+		for (auto& channel : channels)
+		{
+			std::vector<TranslationKey>().swap(channel.translation_keyframes);
+			std::vector<RotationKey>().swap(channel.rotation_keyframes);
+			std::vector<ScaleKey>().swap(channel.scale_keyframes);
+		}
+	}
+
+	DW_LOG_INFO("Compressed animation " + name + " : " + std::to_string(report.source_bytes) + " -> " + std::to_string(report.compressed_bytes) + " bytes, max error (translation: " + std::to_string(report.max_translation_error) + ", rotation: " + std::to_string(report.max_rotation_error) + ", scale: " + std::to_string(report.max_scale_error) + ")");
+
+	return report;
+}
+
 std::string trimmed_name(const std::string& name)
 {
 	size_t pos = name.find_first_of(':');
@@ -6,8 +6,15 @@
 #include <stdint.h>
 #include <vector>
 #include <macros.h>
+#include <algorithm>
 
 #define MAX_BONES 128
+#define QUANTIZED_TIME_MAX 65535.0
+#define KEY_STREAM_COUNT 10
+#define KEY_STREAM_ALIGNMENT 8
+#define CONSTANT_TRACK_TOLERANCE 1e-5f
+#define BAKED_ANIMATION_MAGIC 0x4D494E41 // 'ANIM'
+#define BAKED_ANIMATION_VERSION 1
 
 // Contains the translation, rotation and scale of a single bone.
 struct Keyframe
@@ -17,6 +24,21 @@ struct Keyframe
 	glm::vec3 scale;
 };
 
+// Index of each component when keyframes are stored as separate float streams with one value per bone.
+enum KeyStream
+{
+	KEY_STREAM_TRANSLATION_X = 0,
+	KEY_STREAM_TRANSLATION_Y,
+	KEY_STREAM_TRANSLATION_Z,
+	KEY_STREAM_ROTATION_X,
+	KEY_STREAM_ROTATION_Y,
+	KEY_STREAM_ROTATION_Z,
+	KEY_STREAM_ROTATION_W,
+	KEY_STREAM_SCALE_X,
+	KEY_STREAM_SCALE_Y,
+	KEY_STREAM_SCALE_Z
+};
+
 struct TranslationKey
 {
 	double	  time;
@@ -44,6 +66,43 @@ struct AnimationChannel
 	std::vector<ScaleKey>		scale_keyframes;
 };
 
+// A single track of a compressed channel. Key times are stored as a 16-bit fraction of the clip duration and
+// every key value as three 16-bit integers: range reduced components for translation and scale, smallest-three
+// packed components for rotation.
+struct CompressedTrack
+{
+	glm::vec3			  range_min;
+	glm::vec3			  range_extent;
+	std::vector<uint16_t> times;
+	std::vector<uint16_t> values;
+};
+
+struct CompressedChannel
+{
+	CompressedTrack translation;
+	CompressedTrack rotation;
+	CompressedTrack scale;
+};
+
+// Memory usage and worst case reconstruction error of a compressed clip, measured on the source keys.
+struct CompressionReport
+{
+	size_t source_bytes;
+	size_t compressed_bytes;
+	float  max_translation_error;
+	float  max_rotation_error; // In radians.
+	float  max_scale_error;
+};
+
+// Index of the last key used by each track of a channel. Playback mostly moves forwards
+// by a key or two per frame, so the next search starts from here instead of key 0.
+struct KeyCursor
+{
+	uint32_t translation = 0;
+	uint32_t rotation = 0;
+	uint32_t scale = 0;
+};
+
 // A structure containing Keyframes for each bone at the current point in time of the current animation.
 struct Pose
 {
@@ -57,22 +116,166 @@ struct PoseTransforms
 	DW_ALIGNED(16) glm::mat4 transforms[MAX_BONES];
 };
 
+// A skinning transform without the constant bottom row: the first three rows of the matrix, so a vertex is transformed
+// with three dot products. 48 instead of 64 bytes, laid out like a std140 vec4[3].
+struct CompactTransform
+{
+	glm::vec4 rows[3];
+};
+
+// Compact skinning palette. Only the first 'num_transforms' entries (the skeleton's bone count) are used and uploaded.
+struct CompactPoseTransforms
+{
+	DW_ALIGNED(16) CompactTransform transforms[MAX_BONES];
+	uint32_t num_transforms = 0;
+};
+
 class Skeleton;
+struct KeyReductionSettings;
 
 // Contains an array of Channels.
 struct Animation
 {
-	static Animation* load(const std::string& name, Skeleton* skeleton, bool additive = false, Animation* additive_reference = nullptr);
+	// A non-zero 'sample_rate' (in frames per second) resamples every channel into a dense frame-major array on load.
+	// Keys are reduced with reduce_keyframes() first when 'reduction' is given.
+	static Animation* load(const std::string& name, Skeleton* skeleton, bool additive = false, Animation* additive_reference = nullptr, float sample_rate = 0.0f, const KeyReductionSettings* reduction = nullptr);
+
+	// Loads a clip written by save() without going through Assimp. Returns nullptr if the file is missing, was baked
+	// by another version of the format or targets a skeleton with a different hierarchy.
+	static Animation* load_baked(const std::string& path, Skeleton* skeleton);
+
+	// Writes the clip in whichever representation it currently holds (source keys, compressed or resampled).
+	bool save(const std::string& path, Skeleton* skeleton);
+
+	// Replaces the source keys with 'rate' evenly spaced frames per second, each holding every channel as key streams.
+	void resample(float rate);
+
+	// Start of the key streams of a resampled frame.
+	inline const float* frame(uint32_t idx) const { return &frames[idx * KEY_STREAM_COUNT * frame_stride]; }
+
+	// First key of each track for the given joint, in whichever representation the clip is stored. Missing tracks are identity.
+	Keyframe first_keyframe(uint32_t joint_index);
 
-	std::string					  name;
-	uint32_t					  keyframe_count;
-	std::vector<AnimationChannel> channels;
-	double						  duration;
-	double						  duration_in_ticks;
-	double						  ticks_per_second;
+	// Collapses every track whose keys never change to a single key, or removes it when that key is the same as a missing
+	// track (zero translation, identity rotation, unit scale, which is also an identity additive delta). 'tolerance' is in
+	// scene units for translations and scales and in radians for rotations. Must run on the source keys. Rebuilds
+	// 'animated_joints'.
+	void strip_constant_tracks(float tolerance = CONSTANT_TRACK_TOLERANCE);
+
+	// Rebuilds 'animated_joints' from whichever representation the clip is stored in. Clips assembled in code need
+	// to call this once their keys are in place.
+	void find_animated_joints();
+
+	// Builds the quantized representation of the clip which AnimSample will then decode instead of the source keys.
+	// The source keys are released unless 'keep_source' is set, so a clip still used as an additive reference must be kept.
+	CompressionReport compress(bool keep_source = false);
+
+	std::string					   name;
+	uint32_t					   keyframe_count;
+	std::vector<AnimationChannel>  channels;
+	std::vector<uint32_t>		   animated_joints; // Joints with a track holding more than one key, in ascending order.
+	bool						   compressed = false;
+	std::vector<CompressedChannel> compressed_channels;
+	bool						   resampled = false;
+	float						   sample_rate = 0.0f;
+	uint32_t					   frame_count = 0;
+	uint32_t					   frame_stride = 0; // Channel count padded to KEY_STREAM_ALIGNMENT.
+	std::vector<float>			   frames; // Per frame, KEY_STREAM_COUNT streams of 'frame_stride' values.
+	double						   duration;
+	double						   duration_in_ticks;
+	double						   ticks_per_second;
 };
 
 extern glm::vec3 translation_delta(const glm::vec3& reference, glm::vec3 additive);
 extern glm::vec3 scale_delta(const glm::vec3& reference, glm::vec3 additive);
 extern glm::quat rotation_delta(const glm::quat& reference, glm::quat additive);
-extern std::string trimmed_name(const std::string& name);
\ No newline at end of file
+extern std::string trimmed_name(const std::string& name);
+extern void write_key_stream(float* streams, uint32_t stride, uint32_t idx, const Keyframe& keyframe);
+extern Keyframe read_key_stream(const float* streams, uint32_t stride, uint32_t idx);
+extern glm::quat read_key_stream_rotation(const float* streams, uint32_t stride, uint32_t idx);
+extern Keyframe evaluate_channel(const AnimationChannel& channel, double ticks);
+
+// Frame of a resampled clip to interpolate from at 'ticks', and the factor towards the next frame. The last frame lands on
+// the end of the clip, so the final gap is shorter than a full frame when the duration is not a whole number of frames.
+extern uint32_t resampled_frame(double ticks, double ticks_per_second, float sample_rate, double duration_in_ticks, uint32_t frame_count, float& factor);
+
+// Model space transform of a joint from the model space transform of its parent and its own local transform, composed
+// as rotation and translation. Scale is not applied, matching AnimLocalTransform.
+extern Keyframe compose_keyframe(const Keyframe& parent, const Keyframe& local);
+
+// Translation * rotation matrix of a keyframe, the matrix AnimLocalTransform builds.
+extern glm::mat4 keyframe_matrix(const Keyframe& keyframe);
+
+// Conversion between the full and the compact palette. Unpacking restores the constant bottom row, for tools and tests.
+extern void pack_transforms(const PoseTransforms* transforms, uint32_t count, CompactPoseTransforms* output);
+extern void unpack_transforms(const CompactPoseTransforms* transforms, PoseTransforms* output);
+
+extern glm::vec3 decode_vector(const CompressedTrack& track, uint32_t idx);
+extern glm::quat decode_rotation(const CompressedTrack& track, uint32_t idx);
+
+// Adds the joints of an additive clip whose delta is not always the identity to a sorted list of joints, keeping it
+// sorted and free of duplicates. Additive blends only need to visit these joints.
+extern void merge_additive_joints(Animation* animation, std::vector<uint32_t>& joints);
+
+// Finds the keys surrounding 'ticks' on every track of a channel along with the translation, rotation and scale
+// interpolation factors. Missing tracks return identity keys.
+extern void find_channel_keys(const AnimationChannel& channel, double ticks, KeyCursor& cursor, Keyframe& key_1, Keyframe& key_2, float* factors);
+extern void find_compressed_channel_keys(const CompressedChannel& channel, double quantized_time, KeyCursor& cursor, Keyframe& key_1, Keyframe& key_2, float* factors);
+
+// Maximum number of keys a KeyCursor is allowed to step forward before falling back to a binary search.
+#define MAX_CURSOR_STEPS 4
+
+inline double key_time(uint16_t key)
+{
+	return key;
+}
+
+template <typename T>
+inline double key_time(const T& key)
+{
+	return key.time;
+}
+
+// Returns the index of the first key whose successor lies after 'ticks', or 0 if there is none.
+// 'cursor' holds the result of the previous search and is updated with the new one.
+template <typename T>
+uint32_t find_key(const std::vector<T>& keys, double ticks, uint32_t& cursor)
+{
+	if (keys.size() < 2)
+		return 0;
+
+	const uint32_t last = keys.size() - 1;
+
+	// Past the final key: keep returning the first key like the original linear scan did.
+	if (ticks >= key_time(keys[last]))
+	{
+		cursor = 0;
+		return 0;
+	}
+
+	uint32_t idx = cursor < last ? cursor : 0;
+
+	// Time went backwards (loop wrap or seek). Most of the time this lands back in the first key span.
+	if (idx > 0 && ticks < key_time(keys[idx]))
+		idx = 0;
+
+	// Walk forward a few keys, which covers normal playback.
+	for (uint32_t i = 0; i < MAX_CURSOR_STEPS; i++)
+	{
+		if (ticks < key_time(keys[idx + 1]))
+		{
+			cursor = idx;
+			return idx;
+		}
+
+		idx++;
+	}
+
+	// Large time jump: binary search the remaining keys for the first successor after 'ticks'.
+	auto it = std::upper_bound(keys.begin() + idx + 1, keys.end(), ticks, [](double t, const T& key) { return t < key_time(key); });
+
+	idx = static_cast<uint32_t>(it - keys.begin()) - 1;
+	cursor = idx;
+
+	return idx;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+// Helpers for the baked asset formats. Values are written in their in-memory representation, so baked files are
+// only portable between builds that share the same endianness and struct layout.
+
+template <typename T>
+inline void write_value(std::ofstream& stream, const T& value)
+{
+	stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+inline void write_vector(std::ofstream& stream, const std::vector<T>& values)
+{
+	uint32_t count = values.size();
+	write_value(stream, count);
+
+	if (count > 0)
+		stream.write(reinterpret_cast<const char*>(&values[0]), sizeof(T) * count);
+}
+
+inline void write_string(std::ofstream& stream, const std::string& value)
+{
+	uint32_t length = value.size();
+	write_value(stream, length);
+	stream.write(value.c_str(), length);
+}
+
+// Bytes between the read position and the end of the file. Counts read from a file are checked against it before
+// allocating, so a corrupt count fails the read instead of allocating or reading garbage.
+inline uint64_t remaining_bytes(std::ifstream& stream)
+{
+	if (!stream.good())
+		return 0;
+
+	std::streampos position = stream.tellg();
+	stream.seekg(0, std::ios::end);
+	std::streampos end = stream.tellg();
+	stream.seekg(position);
+
+	return end > position ? static_cast<uint64_t>(end - position) : 0;
+}
+
+template <typename T>
+inline bool read_value(std::ifstream& stream, T& value)
+{
+	stream.read(reinterpret_cast<char*>(&value), sizeof(T));
+	return stream.good();
+}
+
+template <typename T>
+inline bool read_vector(std::ifstream& stream, std::vector<T>& values)
+{
+	uint32_t count = 0;
+
+	if (!read_value(stream, count))
+		return false;
+
+	if (count > remaining_bytes(stream) / sizeof(T))
+	{
+		stream.setstate(std::ios::failbit);
+		return false;
+	}
+
+	values.resize(count);
+
+	if (count > 0)
+		stream.read(reinterpret_cast<char*>(&values[0]), sizeof(T) * count);
+
+	return stream.good();
+}
+
+inline bool read_string(std::ifstream& stream, std::string& value)
+{
+	uint32_t length = 0;
+
+	if (!read_value(stream, length))
+		return false;
+
+	if (length > remaining_bytes(stream))
+	{
+		stream.setstate(std::ios::failbit);
+		return false;
+	}
+
+	value.resize(length);
+
+	if (length > 0)
+		stream.read(&value[0], length);
+
+	return stream.good();
+}
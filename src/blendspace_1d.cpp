@@ -43,25 +43,102 @@ float Blendspace1D::value()
 	return m_value;
 }
 
-Pose* Blendspace1D::evaluate(float dt)
+const Pose* Blendspace1D::evaluate(float dt)
 {
+	int32_t low = -1;
+	int32_t high = -1;
+	float	blend_factor = 0.0f;
+
 	for (uint32_t i = 0; i < m_nodes.size(); i++)
 	{
 		if (m_value == m_nodes[i]->value)
-			return m_nodes[i]->sampler->sample(dt);
+		{
+			low = high = i;
+			break;
+		}
 		else if (m_value < m_nodes[i]->value)
 		{
-			Node* low = m_nodes[i - 1];
-			Node* high = m_nodes[i];
+			low = i - 1;
+			high = i;
+			blend_factor = (m_value - m_nodes[low]->value) / (m_nodes[high]->value - m_nodes[low]->value);
+			break;
+		}
+	}
 
-			float blend_factor = (m_value - low->value) / (high->value - low->value);
+	if (low == -1)
+		return nullptr;
 
-			Pose* low_pose = low->sampler->sample(dt);
-			Pose* high_pose = high->sampler->sample(dt);
+	// A neighbour with (close to) zero weight is not sampled, the other one is passed through unblended.
+	if (blend_factor < BLEND_WEIGHT_EPSILON)
+		high = low;
+	else if (blend_factor > 1.0f - BLEND_WEIGHT_EPSILON)
+		low = high;
 
-			return m_blend->blend(low_pose, high_pose, blend_factor);
+	const Pose* low_pose = nullptr;
+	const Pose* high_pose = nullptr;
+
+	// Every node advances its clock, so that nodes blending back in stay in phase with the ones that were sampled.
+	for (uint32_t i = 0; i < m_nodes.size(); i++)
+	{
+		if (i == (uint32_t)low)
+			low_pose = m_nodes[i]->sampler->sample(dt);
+		else if (i == (uint32_t)high)
+			high_pose = m_nodes[i]->sampler->sample(dt);
+		else
+		{
+			m_nodes[i]->sampler->advance(dt);
+			m_skipped_samples++;
+			continue;
 		}
+
+		m_evaluated_samples++;
 	}
 
-	return nullptr;
+	if (low == high)
+		return low_pose;
+
+	return m_blend->blend(low_pose, high_pose, blend_factor);
+}
+
+void Blendspace1D::advance(float dt)
+{
+	for (auto& node : m_nodes)
+		node->sampler->advance(dt);
+
+	m_skipped_samples += m_nodes.size();
+}
+
+void Blendspace1D::reset_counters()
+{
+	m_evaluated_samples = 0;
+	m_skipped_samples = 0;
+}
+
+void Blendspace1D::set_simd(bool simd)
+{
+	for (auto& node : m_nodes)
+		node->sampler->set_simd(simd);
+}
+
+void Blendspace1D::set_simd_blending(bool simd)
+{
+	m_blend->set_simd(simd);
+}
+
+void Blendspace1D::set_rotation_interpolation(RotationInterpolation mode)
+{
+	for (auto& node : m_nodes)
+		node->sampler->set_rotation_interpolation(mode);
+}
+
+void Blendspace1D::set_pose_cache(PoseCache* cache)
+{
+	for (auto& node : m_nodes)
+		node->sampler->set_pose_cache(cache);
+}
+
+void Blendspace1D::set_lod(uint32_t lod)
+{
+	for (auto& node : m_nodes)
+		node->sampler->set_lod(lod);
 }
\ No newline at end of file
@@ -30,7 +30,20 @@ public:
 	float max();
 	float min();
 	float value();
-	Pose* evaluate(float dt);
+	const Pose* evaluate(float dt);
+	void set_simd(bool simd);
+	void set_simd_blending(bool simd);
+	void set_rotation_interpolation(RotationInterpolation mode);
+	void set_pose_cache(PoseCache* cache);
+	void set_lod(uint32_t lod);
+
+	// Clock-only update of every node, for when the output is not needed this frame.
+	void advance(float dt);
+
+	// Nodes sampled and nodes only advanced (zero weight, or not needed at all) since the last reset.
+	inline uint64_t evaluated_samples() { return m_evaluated_samples; }
+	inline uint64_t skipped_samples() { return m_skipped_samples; }
+	void reset_counters();
 
 private:
 	float m_value = 0.0f;
@@ -38,4 +51,6 @@ private:
 	float m_max = 0.0f;
 	std::vector<Node*> m_nodes;
 	std::unique_ptr<AnimBlend> m_blend;
+	uint64_t m_evaluated_samples = 0;
+	uint64_t m_skipped_samples = 0;
 };
\ No newline at end of file
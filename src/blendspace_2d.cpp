@@ -3,9 +3,7 @@
 
 Blendspace2D::Blendspace2D(Skeleton* skeleton, const std::vector<Row>& rows) : m_rows(rows)
 {
-	m_blend_1 = std::make_unique<AnimBlend>(skeleton);
-	m_blend_2 = std::make_unique<AnimBlend>(skeleton);
-	m_blend_3 = std::make_unique<AnimBlend>(skeleton);
+	m_blend = std::make_unique<AnimBlend>(skeleton);
 
 	assert(m_rows.size() > 0);
 	assert(m_rows[0].nodes.size() > 0);
@@ -92,12 +90,17 @@ float Blendspace2D::value_y()
 	return m_y_value;
 }
 
-Pose* Blendspace2D::evaluate(float dt)
+const Pose* Blendspace2D::evaluate(float dt)
 {
+	m_num_poses = 0;
+
 	for (uint32_t i = 0; i < m_rows.size(); i++)
 	{
 		if (m_y_value == m_rows[i].value)
-			return blended_pose_from_row(m_rows[i], m_blend_1.get(), dt);
+		{
+			add_row_nodes(m_rows[i], 1.0f);
+			break;
+		}
 		else if (m_y_value < m_rows[i].value)
 		{
 			const Row& low = m_rows[i - 1];
@@ -105,43 +108,141 @@ Pose* Blendspace2D::evaluate(float dt)
 
 			float blend_factor = (m_y_value - low.value) / (high.value - low.value);
 
-			Pose* low_pose = blended_pose_from_row(low, m_blend_1.get(), dt);
-			Pose* high_pose = blended_pose_from_row(high, m_blend_2.get(), dt);
+			add_row_nodes(low, 1.0f - blend_factor);
+			add_row_nodes(high, blend_factor);
+			break;
+		}
+	}
+
+	const Pose* poses[4];
+	float	 weights[4];
+	uint32_t num_poses = 0;
+
+	// Nodes outside of the cell, or inside it with (close to) zero weight, only advance their clock, so that they stay
+	// in phase for when they blend back in.
+	for (const auto& row : m_rows)
+	{
+		for (const auto& node : row.nodes)
+		{
+			float weight = 0.0f;
+
+			for (uint32_t i = 0; i < m_num_poses; i++)
+			{
+				if (m_nodes[i] == node)
+					weight += m_weights[i];
+			}
+
+			if (weight < BLEND_WEIGHT_EPSILON)
+			{
+				node->sampler->advance(dt);
+				m_skipped_samples++;
+			}
+			else
+			{
+				poses[num_poses] = node->sampler->sample(dt);
+				weights[num_poses++] = weight;
+				m_evaluated_samples++;
+			}
+		}
+	}
+
+	// Up to four poses with bilinear weights, blended in a single pass instead of two row blends and a column blend. A
+	// single pose is passed through. The weights sum to one, so at least one pose was sampled.
+	assert(num_poses > 0);
 
-			return m_blend_3->blend(low_pose, high_pose, blend_factor);
+	return m_blend->blend_weighted(poses, weights, num_poses);
+}
+
+void Blendspace2D::advance(float dt)
+{
+	for (const auto& row : m_rows)
+	{
+		for (const auto& node : row.nodes)
+		{
+			node->sampler->advance(dt);
+			m_skipped_samples++;
 		}
 	}
+}
 
-	return nullptr;
+void Blendspace2D::reset_counters()
+{
+	m_evaluated_samples = 0;
+	m_skipped_samples = 0;
 }
 
-Pose* Blendspace2D::blended_pose_from_row(const Row& row, AnimBlend* blend, float dt)
+void Blendspace2D::add_row_nodes(const Row& row, float weight)
 {
 	if (row.nodes.size() == 1)
-		return row.nodes[0]->sampler->sample(dt);
+	{
+		add_node(row.nodes[0], weight);
+		return;
+	}
 
 	for (uint32_t j = 0; j < row.nodes.size(); j++)
 	{
 		if (m_x_value == row.nodes[j]->value)
-			return row.nodes[j]->sampler->sample(dt);
+		{
+			add_node(row.nodes[j], weight);
+			return;
+		}
 		else if (m_x_value < row.nodes[j]->value)
 		{
 			Node* low = row.nodes[j - 1];
 			Node* high = row.nodes[j];
 
-			return blended_pose_from_nodes(low, high, blend, dt);
+			float blend_factor = (m_x_value - low->value) / (high->value - low->value);
+
+			add_node(low, weight * (1.0f - blend_factor));
+			add_node(high, weight * blend_factor);
+			return;
 		}
 	}
+}
+
+void Blendspace2D::add_node(Node* node, float weight)
+{
+	m_nodes[m_num_poses] = node;
+	m_weights[m_num_poses++] = weight;
+}
+
+void Blendspace2D::set_simd(bool simd)
+{
+	for (const auto& row : m_rows)
+	{
+		for (const auto& node : row.nodes)
+			node->sampler->set_simd(simd);
+	}
+}
 
-	return nullptr;
+void Blendspace2D::set_simd_blending(bool simd)
+{
+	m_blend->set_simd(simd);
 }
 
-Pose* Blendspace2D::blended_pose_from_nodes(Node* low, Node* high, AnimBlend* blend, float dt)
+void Blendspace2D::set_rotation_interpolation(RotationInterpolation mode)
 {
-	float blend_factor = (m_x_value - low->value) / (high->value - low->value);
+	for (const auto& row : m_rows)
+	{
+		for (const auto& node : row.nodes)
+			node->sampler->set_rotation_interpolation(mode);
+	}
+}
 
-	Pose* low_pose = low->sampler->sample(dt);
-	Pose* high_pose = high->sampler->sample(dt);
+void Blendspace2D::set_pose_cache(PoseCache* cache)
+{
+	for (const auto& row : m_rows)
+	{
+		for (const auto& node : row.nodes)
+			node->sampler->set_pose_cache(cache);
+	}
+}
 
-	return blend->blend(low_pose, high_pose, blend_factor);
+void Blendspace2D::set_lod(uint32_t lod)
+{
+	for (const auto& row : m_rows)
+	{
+		for (const auto& node : row.nodes)
+			node->sampler->set_lod(lod);
+	}
 }
\ No newline at end of file
@@ -38,11 +38,25 @@ public:
 	float max_y();
 	float min_y();
 	float value_y();
-	Pose* evaluate(float dt);
+	const Pose* evaluate(float dt);
+	void set_simd(bool simd);
+	void set_simd_blending(bool simd);
+	void set_rotation_interpolation(RotationInterpolation mode);
+	void set_pose_cache(PoseCache* cache);
+	void set_lod(uint32_t lod);
+
+	// Clock-only update of every node, for when the output is not needed this frame.
+	void advance(float dt);
+
+	// Nodes sampled and nodes only advanced (zero weight, or not needed at all) since the last reset.
+	inline uint64_t evaluated_samples() { return m_evaluated_samples; }
+	inline uint64_t skipped_samples() { return m_skipped_samples; }
+	void reset_counters();
 
 private:
-	Pose* blended_pose_from_row(const Row& row, AnimBlend* blend, float dt);
-	Pose* blended_pose_from_nodes(Node* low, Node* high, AnimBlend* blend, float dt);
+	// Queues the nodes of 'row' surrounding the x value for blending, scaled by 'weight'.
+	void add_row_nodes(const Row& row, float weight);
+	void add_node(Node* node, float weight);
 
 private:
 	float m_x_max;
@@ -52,7 +66,10 @@ private:
 	float m_x_value;
 	float m_y_value;
 	std::vector<Row> m_rows;
-	std::unique_ptr<AnimBlend> m_blend_1;
-	std::unique_ptr<AnimBlend> m_blend_2;
-	std::unique_ptr<AnimBlend> m_blend_3;
+	std::unique_ptr<AnimBlend> m_blend;
+	Node* m_nodes[4];
+	float m_weights[4];
+	uint32_t m_num_poses = 0;
+	uint64_t m_evaluated_samples = 0;
+	uint64_t m_skipped_samples = 0;
 };
\ No newline at end of file
@@ -0,0 +1,401 @@
+#include "blendspace_triangulated.h"
+#include <algorithm>
+#include <limits>
+#include <logger.h>
+
+#define BARYCENTRIC_TOLERANCE 1e-5f
+
+static uint32_t grid_cell(float value, float min, float cell_size)
+{
+	return uint32_t(std::min(std::max((value - min) / cell_size, 0.0f), float(BLENDSPACE_GRID_SIZE - 1)));
+}
+
+BlendspaceTriangulated::BlendspaceTriangulated(Skeleton* skeleton, const std::vector<Node*>& nodes) : m_nodes(nodes)
+{
+	m_blend = std::make_unique<AnimBlend>(skeleton);
+
+	assert(m_nodes.size() > 0);
+
+	m_min = m_nodes[0]->value;
+	m_max = m_nodes[0]->value;
+
+	for (const auto& node : m_nodes)
+	{
+		assert(node != nullptr);
+
+		m_min = glm::vec2(std::min(m_min.x, node->value.x), std::min(m_min.y, node->value.y));
+		m_max = glm::vec2(std::max(m_max.x, node->value.x), std::max(m_max.y, node->value.y));
+	}
+
+	m_value = m_min;
+
+	triangulate();
+	build_grid();
+}
+
+BlendspaceTriangulated::~BlendspaceTriangulated()
+{
+	for (auto& node : m_nodes)
+	{
+		if (node)
+			delete node;
+	}
+}
+
+void BlendspaceTriangulated::set_x_value(float value)
+{
+	m_value.x = std::min(m_max.x, std::max(m_min.x, value));
+}
+
+float BlendspaceTriangulated::max_x()
+{
+	return m_max.x;
+}
+
+float BlendspaceTriangulated::min_x()
+{
+	return m_min.x;
+}
+
+float BlendspaceTriangulated::value_x()
+{
+	return m_value.x;
+}
+
+void BlendspaceTriangulated::set_y_value(float value)
+{
+	m_value.y = std::min(m_max.y, std::max(m_min.y, value));
+}
+
+float BlendspaceTriangulated::max_y()
+{
+	return m_max.y;
+}
+
+float BlendspaceTriangulated::min_y()
+{
+	return m_min.y;
+}
+
+float BlendspaceTriangulated::value_y()
+{
+	return m_value.y;
+}
+
+const Pose* BlendspaceTriangulated::evaluate(float dt)
+{
+	uint32_t nodes[3];
+	float	 weights[3];
+
+	find_weights(nodes, weights);
+
+	const Pose* poses[3];
+	float	 pose_weights[3];
+	uint32_t num_poses = 0;
+
+	// Samples which do not contribute only advance their clock, so that they stay in phase for when they blend back in.
+	for (uint32_t i = 0; i < m_nodes.size(); i++)
+	{
+		float weight = 0.0f;
+
+		for (uint32_t j = 0; j < 3; j++)
+		{
+			if (nodes[j] == i)
+				weight += weights[j];
+		}
+
+		if (weight < BLEND_WEIGHT_EPSILON)
+		{
+			m_nodes[i]->sampler->advance(dt);
+			m_skipped_samples++;
+		}
+		else
+		{
+			poses[num_poses] = m_nodes[i]->sampler->sample(dt);
+			pose_weights[num_poses++] = weight;
+			m_evaluated_samples++;
+		}
+	}
+
+	// The weights sum to one, so at least one pose was sampled.
+	assert(num_poses > 0);
+
+	return m_blend->blend_weighted(poses, pose_weights, num_poses);
+}
+
+void BlendspaceTriangulated::advance(float dt)
+{
+	for (auto& node : m_nodes)
+		node->sampler->advance(dt);
+
+	m_skipped_samples += m_nodes.size();
+}
+
+void BlendspaceTriangulated::reset_counters()
+{
+	m_evaluated_samples = 0;
+	m_skipped_samples = 0;
+}
+
+void BlendspaceTriangulated::find_weights(uint32_t* nodes, float* weights)
+{
+	if (m_triangles.size() == 0)
+	{
+		// Fewer than three samples, or all of them on a line: use the closest one.
+		uint32_t closest = 0;
+
+		for (uint32_t i = 1; i < m_nodes.size(); i++)
+		{
+			if (glm::length(m_nodes[i]->value - m_value) < glm::length(m_nodes[closest]->value - m_value))
+				closest = i;
+		}
+
+		nodes[0] = nodes[1] = nodes[2] = closest;
+		weights[0] = 1.0f;
+		weights[1] = weights[2] = 0.0f;
+
+		return;
+	}
+
+	uint32_t cell_idx = grid_cell(m_value.y, m_min.y, m_cell_size.y) * BLENDSPACE_GRID_SIZE + grid_cell(m_value.x, m_min.x, m_cell_size.x);
+
+	for (uint32_t triangle_idx : m_cells[cell_idx])
+	{
+		const Triangle& triangle = m_triangles[triangle_idx];
+
+		if (barycentric(triangle, m_value, weights))
+		{
+			std::copy(triangle.nodes, triangle.nodes + 3, nodes);
+			return;
+		}
+	}
+
+	// Outside of the convex hull: blend along the closest triangle edge.
+	float closest_distance = std::numeric_limits<float>::max();
+
+	for (const auto& triangle : m_triangles)
+	{
+		for (uint32_t e = 0; e < 3; e++)
+		{
+			uint32_t  i0 = e;
+			uint32_t  i1 = (e + 1) % 3;
+			glm::vec2 a = m_nodes[triangle.nodes[i0]]->value;
+			glm::vec2 b = m_nodes[triangle.nodes[i1]]->value;
+			glm::vec2 edge = b - a;
+			float	  s = glm::clamp(glm::dot(m_value - a, edge) / glm::dot(edge, edge), 0.0f, 1.0f);
+			float	  distance = glm::length(a + edge * s - m_value);
+
+			if (distance < closest_distance)
+			{
+				closest_distance = distance;
+
+				std::copy(triangle.nodes, triangle.nodes + 3, nodes);
+				weights[i0] = 1.0f - s;
+				weights[i1] = s;
+				weights[(e + 2) % 3] = 0.0f;
+			}
+		}
+	}
+}
+
+bool BlendspaceTriangulated::barycentric(const Triangle& triangle, const glm::vec2& p, float* weights)
+{
+	glm::vec2 a = m_nodes[triangle.nodes[0]]->value;
+	glm::vec2 v0 = m_nodes[triangle.nodes[1]]->value - a;
+	glm::vec2 v1 = m_nodes[triangle.nodes[2]]->value - a;
+	glm::vec2 v2 = p - a;
+
+	float d00 = glm::dot(v0, v0);
+	float d01 = glm::dot(v0, v1);
+	float d11 = glm::dot(v1, v1);
+	float d20 = glm::dot(v2, v0);
+	float d21 = glm::dot(v2, v1);
+	float denom = d00 * d11 - d01 * d01;
+
+	float v = (d11 * d20 - d01 * d21) / denom;
+	float w = (d00 * d21 - d01 * d20) / denom;
+	float u = 1.0f - v - w;
+
+	if (u < -BARYCENTRIC_TOLERANCE || v < -BARYCENTRIC_TOLERANCE || w < -BARYCENTRIC_TOLERANCE)
+		return false;
+
+	// Points on an edge may come out slightly negative.
+	u = std::max(u, 0.0f);
+	v = std::max(v, 0.0f);
+	w = std::max(w, 0.0f);
+
+	float sum = u + v + w;
+
+	weights[0] = u / sum;
+	weights[1] = v / sum;
+	weights[2] = w / sum;
+
+	return true;
+}
+
+// Bowyer-Watson: insert the samples one at a time into a triangulation of a triangle enclosing all of them, replacing
+// every triangle whose circumcircle contains the new sample by a fan around it.
+void BlendspaceTriangulated::triangulate()
+{
+	struct Circumcircle
+	{
+		uint32_t nodes[3];
+		double	 x, y, radius_sq;
+	};
+
+	struct Point
+	{
+		double x, y;
+	};
+
+	std::vector<Point> points;
+
+	for (const auto& node : m_nodes)
+		points.push_back({ node->value.x, node->value.y });
+
+	uint32_t num_nodes = points.size();
+	double	 center_x = (double(m_min.x) + double(m_max.x)) * 0.5;
+	double	 center_y = (double(m_min.y) + double(m_max.y)) * 0.5;
+	double	 extent = std::max(1.0, double(std::max(m_max.x - m_min.x, m_max.y - m_min.y))) * 16.0;
+
+	points.push_back({ center_x - extent, center_y - extent });
+	points.push_back({ center_x + extent, center_y - extent });
+	points.push_back({ center_x, center_y + extent });
+
+	auto make_triangle = [&points](uint32_t a, uint32_t b, uint32_t c) {
+		Circumcircle triangle = { { a, b, c }, 0.0, 0.0, -1.0 };
+
+		const Point& pa = points[a];
+		const Point& pb = points[b];
+		const Point& pc = points[c];
+		double		 d = 2.0 * (pa.x * (pb.y - pc.y) + pb.x * (pc.y - pa.y) + pc.x * (pa.y - pb.y));
+
+		// Collinear triangles never contain anything, give them an empty circumcircle.
+		if (fabs(d) < 1e-12)
+			return triangle;
+
+		double a_sq = pa.x * pa.x + pa.y * pa.y;
+		double b_sq = pb.x * pb.x + pb.y * pb.y;
+		double c_sq = pc.x * pc.x + pc.y * pc.y;
+
+		triangle.x = (a_sq * (pb.y - pc.y) + b_sq * (pc.y - pa.y) + c_sq * (pa.y - pb.y)) / d;
+		triangle.y = (a_sq * (pc.x - pb.x) + b_sq * (pa.x - pc.x) + c_sq * (pb.x - pa.x)) / d;
+		triangle.radius_sq = (pa.x - triangle.x) * (pa.x - triangle.x) + (pa.y - triangle.y) * (pa.y - triangle.y);
+
+		return triangle;
+	};
+
+	std::vector<Circumcircle> triangles = { make_triangle(num_nodes, num_nodes + 1, num_nodes + 2) };
+
+	for (uint32_t i = 0; i < num_nodes; i++)
+	{
+		std::vector<std::pair<uint32_t, uint32_t>> edges;
+		std::vector<Circumcircle>				   remaining;
+
+		for (const auto& triangle : triangles)
+		{
+			double dx = points[i].x - triangle.x;
+			double dy = points[i].y - triangle.y;
+
+			// Strict test, so that co-circular samples (any grid) keep the existing triangles.
+			if (dx * dx + dy * dy < triangle.radius_sq * (1.0 - 1e-9))
+			{
+				for (uint32_t e = 0; e < 3; e++)
+					edges.push_back(std::make_pair(triangle.nodes[e], triangle.nodes[(e + 1) % 3]));
+			}
+			else
+				remaining.push_back(triangle);
+		}
+
+		triangles.swap(remaining);
+
+		// Edges shared by two removed triangles are interior to the hole; the others form its boundary.
+		for (uint32_t e = 0; e < edges.size(); e++)
+		{
+			bool shared = false;
+
+			for (uint32_t f = 0; f < edges.size(); f++)
+			{
+				if (e != f && edges[e].first == edges[f].second && edges[e].second == edges[f].first)
+				{
+					shared = true;
+					break;
+				}
+			}
+
+			if (!shared)
+				triangles.push_back(make_triangle(edges[e].first, edges[e].second, i));
+		}
+	}
+
+	m_triangles.clear();
+
+	for (const auto& triangle : triangles)
+	{
+		if (triangle.radius_sq < 0.0 || triangle.nodes[0] >= num_nodes || triangle.nodes[1] >= num_nodes || triangle.nodes[2] >= num_nodes)
+			continue;
+
+		Triangle result;
+		std::copy(triangle.nodes, triangle.nodes + 3, result.nodes);
+		m_triangles.push_back(result);
+	}
+
+	if (m_triangles.size() == 0)
+		DW_LOG_ERROR("Blendspace samples do not span an area, falling back to the closest sample");
+}
+
+void BlendspaceTriangulated::build_grid()
+{
+	m_cell_size = glm::vec2(std::max((m_max.x - m_min.x) / BLENDSPACE_GRID_SIZE, 1e-6f), std::max((m_max.y - m_min.y) / BLENDSPACE_GRID_SIZE, 1e-6f));
+	m_cells.resize(BLENDSPACE_GRID_SIZE * BLENDSPACE_GRID_SIZE);
+
+	// Every cell lists the triangles whose bounds overlap it.
+	for (uint32_t i = 0; i < m_triangles.size(); i++)
+	{
+		glm::vec2 min = m_nodes[m_triangles[i].nodes[0]]->value;
+		glm::vec2 max = min;
+
+		for (uint32_t j = 1; j < 3; j++)
+		{
+			const glm::vec2& value = m_nodes[m_triangles[i].nodes[j]]->value;
+
+			min = glm::vec2(std::min(min.x, value.x), std::min(min.y, value.y));
+			max = glm::vec2(std::max(max.x, value.x), std::max(max.y, value.y));
+		}
+
+		for (uint32_t y = grid_cell(min.y, m_min.y, m_cell_size.y); y <= grid_cell(max.y, m_min.y, m_cell_size.y); y++)
+		{
+			for (uint32_t x = grid_cell(min.x, m_min.x, m_cell_size.x); x <= grid_cell(max.x, m_min.x, m_cell_size.x); x++)
+				m_cells[y * BLENDSPACE_GRID_SIZE + x].push_back(i);
+		}
+	}
+}
+
+void BlendspaceTriangulated::set_simd(bool simd)
+{
+	for (auto& node : m_nodes)
+		node->sampler->set_simd(simd);
+}
+
+void BlendspaceTriangulated::set_simd_blending(bool simd)
+{
+	m_blend->set_simd(simd);
+}
+
+void BlendspaceTriangulated::set_rotation_interpolation(RotationInterpolation mode)
+{
+	for (auto& node : m_nodes)
+		node->sampler->set_rotation_interpolation(mode);
+}
+
+void BlendspaceTriangulated::set_pose_cache(PoseCache* cache)
+{
+	for (auto& node : m_nodes)
+		node->sampler->set_pose_cache(cache);
+}
+
+void BlendspaceTriangulated::set_lod(uint32_t lod)
+{
+	for (auto& node : m_nodes)
+		node->sampler->set_lod(lod);
+}
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "skeletal_mesh.h"
+#include "anim_sample.h"
+#include "anim_blend.h"
+
+#define BLENDSPACE_GRID_SIZE 8
+
+// 2D blendspace over arbitrarily placed samples. The samples are Delaunay triangulated once, and evaluation blends the
+// (at most three) samples of the triangle containing the blend value with barycentric weights. Values outside of the
+// convex hull of the samples are moved to the closest point on it.
+class BlendspaceTriangulated
+{
+public:
+	struct Node
+	{
+		glm::vec2					value;
+		Animation*					anim;
+		std::unique_ptr<AnimSample> sampler;
+
+		Node(Skeleton* _skeleton, Animation* _anim, float _x, float _y)
+		{
+			anim = _anim;
+			sampler = std::make_unique<AnimSample>(_skeleton, _anim);
+			value = glm::vec2(_x, _y);
+		}
+	};
+
+public:
+	BlendspaceTriangulated(Skeleton* skeleton, const std::vector<Node*>& nodes);
+	~BlendspaceTriangulated();
+	void set_x_value(float value);
+	float max_x();
+	float min_x();
+	float value_x();
+	void set_y_value(float value);
+	float max_y();
+	float min_y();
+	float value_y();
+	const Pose* evaluate(float dt);
+	void set_simd(bool simd);
+	void set_simd_blending(bool simd);
+	void set_rotation_interpolation(RotationInterpolation mode);
+	void set_pose_cache(PoseCache* cache);
+	void set_lod(uint32_t lod);
+
+	// Clock-only update of every node, for when the output is not needed this frame.
+	void advance(float dt);
+
+	// Nodes sampled and nodes only advanced (zero weight, or not needed at all) since the last reset.
+	inline uint64_t evaluated_samples() { return m_evaluated_samples; }
+	inline uint64_t skipped_samples() { return m_skipped_samples; }
+	void reset_counters();
+
+	// Samples and weights of the current blend value. Weights sum to one.
+	void find_weights(uint32_t* nodes, float* weights);
+
+private:
+	struct Triangle
+	{
+		uint32_t nodes[3];
+	};
+
+	void triangulate();
+	void build_grid();
+	bool barycentric(const Triangle& triangle, const glm::vec2& p, float* weights);
+
+private:
+	glm::vec2							m_min;
+	glm::vec2							m_max;
+	glm::vec2							m_value;
+	glm::vec2							m_cell_size;
+	std::vector<Node*>					m_nodes;
+	std::vector<Triangle>				m_triangles;
+	std::vector<std::vector<uint32_t>> m_cells;
+	std::unique_ptr<AnimBlend>			m_blend;
+	uint64_t							m_evaluated_samples = 0;
+	uint64_t							m_skipped_samples = 0;
+};
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "bone_mask.h"
+#include <logger.h>
+
+BoneMask::BoneMask(Skeleton* skeleton, const std::string& root_joint, float weight) : m_weights(skeleton->num_bones(), 0.0f)
+{
+	set_subtree_weight(skeleton, root_joint, weight);
+	find_joints();
+}
+
+BoneMask::BoneMask(Skeleton* skeleton, const std::vector<std::pair<std::string, float>>& joint_weights) : m_weights(skeleton->num_bones(), 0.0f)
+{
+	for (const auto& joint_weight : joint_weights)
+		set_subtree_weight(skeleton, joint_weight.first, joint_weight.second);
+
+	find_joints();
+}
+
+BoneMask::~BoneMask()
+{
+
+}
+
+void BoneMask::set_subtree_weight(Skeleton* skeleton, const std::string& root_joint, float weight)
+{
+	int32_t root = skeleton->find_joint_index(root_joint);
+
+	if (root == -1)
+	{
+		DW_LOG_ERROR("Unknown joint in bone mask : " + root_joint);
+		return;
+	}
+
+	Joint*			  joints = skeleton->joints();
+	std::vector<bool> in_subtree(skeleton->num_bones(), false);
+
+	// Parents come before their children, so a single pass from the root marks the whole subtree.
+	in_subtree[root] = true;
+	m_weights[root] = weight;
+
+	for (uint32_t i = root + 1; i < skeleton->num_bones(); i++)
+	{
+		if (joints[i].parent_index != -1 && in_subtree[joints[i].parent_index])
+		{
+			in_subtree[i] = true;
+			m_weights[i] = weight;
+		}
+	}
+}
+
+void BoneMask::find_joints()
+{
+	m_joints.clear();
+
+	for (uint32_t i = 0; i < m_weights.size(); i++)
+	{
+		if (m_weights[i] != 0.0f)
+			m_joints.push_back(i);
+	}
+}
\ No newline at end of file
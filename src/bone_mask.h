@@ -0,0 +1,31 @@
+#pragma once
+
+#include "skeletal_mesh.h"
+
+// Per-joint blend weights resolved once against a skeleton, so that partial blends need no joint name lookups or
+// hierarchy walks per frame. Built after Skeleton::build_lods(), since that reorders the joints.
+class BoneMask
+{
+public:
+	// Weight 'weight' for 'root_joint' and all of its descendants, zero elsewhere.
+	BoneMask(Skeleton* skeleton, const std::string& root_joint, float weight = 1.0f);
+
+	// Each entry sets the weight of a joint and its descendants; later entries override earlier ones, so a graded mask
+	// can be described as e.g. { { "spine_01", 0.25f }, { "spine_02", 0.5f }, { "spine_03", 1.0f } }.
+	BoneMask(Skeleton* skeleton, const std::vector<std::pair<std::string, float>>& joint_weights);
+	~BoneMask();
+
+	inline float weight(uint32_t joint) const { return m_weights[joint]; }
+	inline const float* weights() const { return &m_weights[0]; }
+
+	// Joints with a non-zero weight, in increasing order.
+	inline const std::vector<uint32_t>& joints() const { return m_joints; }
+
+private:
+	void set_subtree_weight(Skeleton* skeleton, const std::string& root_joint, float weight);
+	void find_joints();
+
+private:
+	std::vector<float>	  m_weights;
+	std::vector<uint32_t> m_joints;
+};
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "dirty_hierarchy.h"
+#include <algorithm>
+
+DirtyHierarchy::DirtyHierarchy(Skeleton* skeleton) : m_skeleton(skeleton), m_first_dirty_joint(skeleton->num_bones())
+{
+	for (int i = 0; i < MAX_BONES; i++)
+		m_dirty[i] = false;
+
+	m_dirty_joints.reserve(MAX_BONES);
+}
+
+DirtyHierarchy::~DirtyHierarchy()
+{
+
+}
+
+void DirtyHierarchy::mark_dirty(uint32_t joint)
+{
+	if (m_dirty[joint])
+		return;
+
+	m_dirty[joint] = true;
+	m_dirty_joints.push_back(joint);
+	m_first_dirty_joint = std::min(m_first_dirty_joint, joint);
+}
+
+template <typename Compose>
+void DirtyHierarchy::update_subtrees(Compose compose)
+{
+	Joint*			joints = m_skeleton->joints();
+	const uint32_t* subtree_joints = m_skeleton->subtree_joints();
+
+	// Visiting dirty joints in depth-first order lets a subtree nested in one already updated be skipped.
+	std::sort(m_dirty_joints.begin(), m_dirty_joints.end(), [this](uint32_t a, uint32_t b) { return m_skeleton->subtree_begin(a) < m_skeleton->subtree_begin(b); });
+
+	uint32_t updated_end = 0;
+
+	for (uint32_t dirty_joint : m_dirty_joints)
+	{
+		if (m_skeleton->subtree_begin(dirty_joint) < updated_end)
+			continue;
+
+		updated_end = m_skeleton->subtree_end(dirty_joint);
+
+		for (uint32_t i = m_skeleton->subtree_begin(dirty_joint) + 1; i < updated_end; i++)
+		{
+			uint32_t joint = subtree_joints[i];
+
+			if (!m_dirty[joint])
+				compose(joint, joints[joint].parent_index);
+		}
+	}
+
+	for (uint32_t dirty_joint : m_dirty_joints)
+		m_dirty[dirty_joint] = false;
+
+	m_dirty_joints.clear();
+	m_first_dirty_joint = m_skeleton->num_bones();
+}
+
+void DirtyHierarchy::update(PoseTransforms* global_transforms, PoseTransforms* local_transforms)
+{
+	// Local transforms of culled joints are identity, so they follow their parent without a special case.
+	update_subtrees([global_transforms, local_transforms](uint32_t joint, int32_t parent) {
+		global_transforms->transforms[joint] = global_transforms->transforms[parent] * local_transforms->transforms[joint];
+	});
+}
+
+void DirtyHierarchy::update(Pose* global_pose, const Pose* local_pose)
+{
+	update_subtrees([global_pose, local_pose](uint32_t joint, int32_t parent) {
+		if (joint < local_pose->num_keyframes)
+			global_pose->keyframes[joint] = compose_keyframe(global_pose->keyframes[parent], local_pose->keyframes[joint]);
+		else
+			global_pose->keyframes[joint] = global_pose->keyframes[parent];
+	});
+}
\ No newline at end of file
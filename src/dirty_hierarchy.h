@@ -0,0 +1,35 @@
+#pragma once
+
+#include "skeletal_mesh.h"
+
+// Incremental update of a model space pose after some of its joints were modified directly (e.g. by an IK solver).
+// Modified joints are marked dirty and update() recomputes only their descendants from the local pose, using the
+// subtree ranges of the skeleton, so the cost is proportional to the bones touched rather than the skeleton size.
+class DirtyHierarchy
+{
+public:
+	DirtyHierarchy(Skeleton* skeleton);
+	~DirtyHierarchy();
+
+	// The model space transform of 'joint' was written directly. It is kept as is, its descendants are recomputed.
+	void mark_dirty(uint32_t joint);
+
+	// Lowest dirty joint index, or the bone count if none is dirty. Descendants always have higher indices, so every joint
+	// before it is unchanged by update().
+	inline uint32_t first_dirty_joint() { return m_first_dirty_joint; }
+
+	// Recomputes the descendants of the dirty joints in place and clears them. Joints outside of the local pose's bone
+	// LOD follow their parent, as in AnimGlobalTransform.
+	void update(PoseTransforms* global_transforms, PoseTransforms* local_transforms);
+	void update(Pose* global_pose, const Pose* local_pose);
+
+private:
+	template <typename Compose>
+	void update_subtrees(Compose compose);
+
+private:
+	Skeleton*			  m_skeleton;
+	std::vector<uint32_t> m_dirty_joints;
+	bool				  m_dirty[MAX_BONES];
+	uint32_t			  m_first_dirty_joint;
+};
\ No newline at end of file
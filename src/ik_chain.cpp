@@ -0,0 +1,64 @@
+#include "ik_chain.h"
+#include <algorithm>
+#include <logger.h>
+
+IKChain::IKChain(Skeleton* skeleton, const std::string& start_joint, const std::string& end_joint)
+{
+	int32_t start_idx = skeleton->find_joint_index(start_joint);
+
+	if (start_idx == -1)
+	{
+		DW_LOG_ERROR("IK Chain: Requested start joint not found = " + start_joint);
+		return;
+	}
+
+	int32_t end_idx = skeleton->find_joint_index(end_joint);
+
+	if (end_idx == -1)
+	{
+		DW_LOG_ERROR("IK Chain: Requested end joint not found = " + end_joint);
+		return;
+	}
+
+	Joint*	joints = skeleton->joints();
+	int32_t idx = end_idx;
+
+	while (idx != -1 && idx != start_idx)
+	{
+		m_joints.push_back(idx);
+		idx = joints[idx].parent_index;
+	}
+
+	if (idx == -1)
+	{
+		DW_LOG_ERROR("IK Chain: " + end_joint + " is not a descendant of " + start_joint);
+		m_joints.clear();
+		return;
+	}
+
+	m_joints.push_back(start_idx);
+
+	if (m_joints.size() < 2 || m_joints.size() > MAX_IK_CHAIN_SIZE)
+	{
+		DW_LOG_ERROR("IK Chain: " + start_joint + " to " + end_joint + " must have between 2 and MAX_IK_CHAIN_SIZE joints");
+		m_joints.clear();
+		return;
+	}
+
+	std::reverse(m_joints.begin(), m_joints.end());
+
+	// The bind pose transform of a joint is the inverse of its offset transform.
+	for (uint32_t i = 0; i < m_joints.size() - 1; i++)
+	{
+		glm::vec3 start_pos = glm::vec3(glm::inverse(joints[m_joints[i]].offset_transform)[3]);
+		glm::vec3 end_pos = glm::vec3(glm::inverse(joints[m_joints[i + 1]].offset_transform)[3]);
+
+		m_bone_lengths.push_back(glm::length(end_pos - start_pos));
+		m_length += m_bone_lengths.back();
+	}
+}
+
+IKChain::~IKChain()
+{
+
+}
\ No newline at end of file
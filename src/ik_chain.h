@@ -0,0 +1,30 @@
+#pragma once
+
+#include "skeletal_mesh.h"
+
+#define MAX_IK_CHAIN_SIZE 8
+
+// A chain of joints from 'start_joint' down to 'end_joint' along the real parent path, resolved once against a skeleton
+// so that solvers do no name lookups or chain discovery per frame. The joints need not be contiguous in the skeleton.
+// Built after Skeleton::build_lods(), since that reorders the joints.
+class IKChain
+{
+public:
+	IKChain(Skeleton* skeleton, const std::string& start_joint, const std::string& end_joint);
+	~IKChain();
+
+	// False if a joint is missing, 'end_joint' is not below 'start_joint' or the chain has fewer than two or more than
+	// MAX_IK_CHAIN_SIZE joints.
+	inline bool valid() const { return !m_joints.empty(); }
+	inline uint32_t num_joints() const { return m_joints.size(); }
+	inline uint32_t joint(uint32_t idx) const { return m_joints[idx]; }
+
+	// Model space rest pose distances between consecutive joints, from the bind pose of the skeleton.
+	inline const float* bone_lengths() const { return &m_bone_lengths[0]; }
+	inline float length() const { return m_length; }
+
+private:
+	std::vector<uint32_t> m_joints;
+	std::vector<float>	  m_bone_lengths;
+	float				  m_length = 0.0f;
+};
\ No newline at end of file
@@ -0,0 +1,258 @@
+#include "keyframe_reduction.h"
+#include "skeleton.h"
+#include <logger.h>
+#include <gtc/matrix_transform.hpp>
+#define GLM_ENABLE_EXPERIMENTAL
+#include <gtx/quaternion.hpp>
+#include <gtx/compatibility.hpp>
+#include <algorithm>
+#include <map>
+
+// Global transforms of the source clip, and of the clip as reduced so far, at a single point in time.
+struct ReferencePose
+{
+	std::vector<Keyframe>  locals;
+	std::vector<glm::mat4> globals;
+	std::vector<glm::mat4> reduced_globals;
+	uint32_t			   num_reduced = 0;
+};
+
+// Joints are reduced in order, so that parents are final before their children are measured (Skeleton keeps parents
+// before their children, see build_lods()). Transforms are composed like the runtime does, see keyframe_matrix().
+class ReferencePoseCache
+{
+public:
+	// Keeps a copy of the source channels since the clip is reduced in place while the cache is in use.
+	ReferencePoseCache(Animation* animation, Skeleton* skeleton) : m_channels(animation->channels), m_animation(animation), m_skeleton(skeleton) {}
+
+	// Pose at 'ticks' whose reduced globals are valid for the first 'num_reduced' joints, which must not change anymore.
+	const ReferencePose& pose(double ticks, uint32_t num_reduced)
+	{
+		ReferencePose& pose = m_poses[ticks];
+		Joint*		   joints = m_skeleton->joints();
+
+		if (pose.globals.empty())
+		{
+			pose.locals.resize(m_skeleton->num_bones());
+			pose.globals.resize(m_skeleton->num_bones());
+			pose.reduced_globals.resize(m_skeleton->num_bones());
+
+			for (uint32_t i = 0; i < m_skeleton->num_bones(); i++)
+			{
+				pose.locals[i] = evaluate_channel(m_channels[i], ticks);
+				pose.globals[i] = global_transform(pose.globals, joints[i].parent_index, pose.locals[i]);
+			}
+		}
+
+		for (; pose.num_reduced < num_reduced; pose.num_reduced++)
+		{
+			uint32_t i = pose.num_reduced;
+			pose.reduced_globals[i] = global_transform(pose.reduced_globals, joints[i].parent_index, evaluate_channel(m_animation->channels[i], ticks));
+		}
+
+		return pose;
+	}
+
+	// Times at which the clip has been measured so far.
+	std::vector<double> times() const
+	{
+		std::vector<double> result;
+
+		for (const auto& pose : m_poses)
+			result.push_back(pose.first);
+
+		return result;
+	}
+
+	static glm::mat4 global_transform(const std::vector<glm::mat4>& globals, int32_t parent_index, const Keyframe& local)
+	{
+		return parent_index == -1 ? keyframe_matrix(local) : globals[parent_index] * keyframe_matrix(local);
+	}
+
+private:
+	std::vector<AnimationChannel>	m_channels;
+	Animation*						m_animation;
+	Skeleton*						m_skeleton;
+	std::map<double, ReferencePose> m_poses;
+};
+
+// Largest world space distance between the source pose and the reduced one, over the position of every joint in the
+// subtree and virtual points 'shell_distance' away from each of them, when the local transform of the subtree root is
+// replaced by 'modified'. Ancestors are taken from the reduced clip and descendants from the source one.
+static float world_error(Skeleton* skeleton, const std::vector<uint32_t>& subtree, uint32_t joint_index, const ReferencePose& pose, const Keyframe& modified, float shell_distance)
+{
+	Joint* joints = skeleton->joints();
+
+	glm::mat4 world = ReferencePoseCache::global_transform(pose.reduced_globals, joints[joint_index].parent_index, modified);
+
+	// Maps points from the source pose into the reduced one.
+	glm::mat4 delta = world * glm::inverse(pose.globals[joint_index]);
+
+	float error = 0.0f;
+
+	for (uint32_t idx : subtree)
+	{
+		// Virtual points around the joint, so that leaf joints still account for the skin they move.
+		for (int axis = 0; axis < 4; axis++)
+		{
+			glm::vec4 offset = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+			if (axis < 3)
+				offset[axis] = shell_distance;
+
+			glm::vec4 p = pose.globals[idx] * offset;
+			error = std::max(error, glm::length(glm::vec3(delta * p) - glm::vec3(p)));
+		}
+	}
+
+	return error;
+}
+
+template <typename T>
+static float interpolation_factor(const T& a, const T& b, double ticks)
+{
+	double delta = b.time - a.time;
+
+	return delta > 0.0 ? static_cast<float>((ticks - a.time) / delta) : 0.0f;
+}
+
+// Recursively splits the span between two kept keys at the key with the largest error until every span is within tolerance.
+template <typename T, typename F>
+static void reduce_span(const std::vector<T>& keys, uint32_t first, uint32_t last, float tolerance, F& error, std::vector<bool>& keep, float& max_error)
+{
+	if (last - first < 2)
+		return;
+
+	float span_error = 0.0f;
+	uint32_t span_idx = first;
+
+	for (uint32_t i = first + 1; i < last; i++)
+	{
+		float e = error(keys[first], keys[last], keys[i].time);
+
+		if (e > span_error)
+		{
+			span_error = e;
+			span_idx = i;
+		}
+	}
+
+	if (span_error <= tolerance)
+	{
+		max_error = std::max(max_error, span_error);
+		return;
+	}
+
+	keep[span_idx] = true;
+
+	reduce_span(keys, first, span_idx, tolerance, error, keep, max_error);
+	reduce_span(keys, span_idx, last, tolerance, error, keep, max_error);
+}
+
+template <typename T, typename F>
+static void reduce_track(std::vector<T>& keys, float tolerance, F error, float& max_error)
+{
+	if (keys.size() < 3)
+		return;
+
+	std::vector<bool> keep(keys.size(), false);
+
+	keep.front() = true;
+	keep.back() = true;
+
+	reduce_span(keys, 0, keys.size() - 1, tolerance, error, keep, max_error);
+
+	uint32_t count = 0;
+
+	for (uint32_t i = 0; i < keys.size(); i++)
+	{
+		if (keep[i])
+			keys[count++] = keys[i];
+	}
+
+	keys.resize(count);
+}
+
+KeyReductionReport reduce_keyframes(Animation* animation, Skeleton* skeleton, const KeyReductionSettings& settings)
+{
+	KeyReductionReport report;
+
+	report.source_keys = 0;
+	report.reduced_keys = 0;
+	report.max_error = 0.0f;
+	report.max_scale_error = 0.0f;
+
+	if (animation->resampled || animation->compressed)
+	{
+		DW_LOG_ERROR("Keyframe reduction requires the source keys : " + animation->name);
+		return report;
+	}
+
+	Joint* joints = skeleton->joints();
+	ReferencePoseCache cache(animation, skeleton);
+
+	// Errors of the tracks of a joint are measured on top of its already reduced ancestors and tracks, so they do not add up.
+	for (uint32_t i = 0; i < skeleton->num_bones(); i++)
+	{
+		AnimationChannel& channel = animation->channels[i];
+		float			  track_error = 0.0f; // Unused, the world space error is measured on the final clip below.
+
+		report.source_keys += channel.translation_keyframes.size() + channel.rotation_keyframes.size() + channel.scale_keyframes.size();
+
+		// The joint itself followed by every joint below it in the hierarchy.
+		std::vector<uint32_t> subtree;
+
+		for (uint32_t j = i; j < skeleton->num_bones(); j++)
+		{
+			int32_t parent = j;
+
+			while (parent != -1 && parent != (int32_t)i)
+				parent = joints[parent].parent_index;
+
+			if (parent == (int32_t)i)
+				subtree.push_back(j);
+		}
+
+		// Translation Keyframes
+		reduce_track(channel.translation_keyframes, settings.translation_tolerance, [&](const TranslationKey& a, const TranslationKey& b, double ticks) {
+			Keyframe modified = evaluate_channel(channel, ticks);
+			modified.translation = glm::lerp(a.translation, b.translation, interpolation_factor(a, b, ticks));
+
+			return world_error(skeleton, subtree, i, cache.pose(ticks, i), modified, settings.shell_distance);
+		}, track_error);
+
+		// Rotation Keyframes
+		reduce_track(channel.rotation_keyframes, settings.rotation_tolerance, [&](const RotationKey& a, const RotationKey& b, double ticks) {
+			Keyframe modified = evaluate_channel(channel, ticks);
+			modified.rotation = glm::slerp(a.rotation, b.rotation, interpolation_factor(a, b, ticks));
+
+			return world_error(skeleton, subtree, i, cache.pose(ticks, i), modified, settings.shell_distance);
+		}, track_error);
+
+		// Scale Keyframes. The runtime does not apply scale, so the error is the change of the local scale.
+		reduce_track(channel.scale_keyframes, settings.scale_tolerance, [&](const ScaleKey& a, const ScaleKey& b, double ticks) {
+			glm::vec3 delta = glm::abs(glm::lerp(a.scale, b.scale, interpolation_factor(a, b, ticks)) - cache.pose(ticks, i).locals[i].scale);
+			return std::max(delta.x, std::max(delta.y, delta.z));
+		}, report.max_scale_error);
+
+		report.reduced_keys += channel.translation_keyframes.size() + channel.rotation_keyframes.size() + channel.scale_keyframes.size();
+	}
+
+	// Measured again on the final clip, which also covers the joints whose tracks were left untouched.
+	for (double ticks : cache.times())
+	{
+		const ReferencePose& pose = cache.pose(ticks, skeleton->num_bones());
+
+		for (uint32_t i = 0; i < skeleton->num_bones(); i++)
+		{
+			std::vector<uint32_t> joint = { i };
+			report.max_error = std::max(report.max_error, world_error(skeleton, joint, i, pose, evaluate_channel(animation->channels[i], ticks), settings.shell_distance));
+		}
+	}
+
+	animation->find_animated_joints();
+
+	DW_LOG_INFO("Reduced animation " + animation->name + " : " + std::to_string(report.source_keys) + " -> " + std::to_string(report.reduced_keys) + " keys, max error " + std::to_string(report.max_error) + ", max scale error " + std::to_string(report.max_scale_error));
+
+	return report;
+}
\ No newline at end of file
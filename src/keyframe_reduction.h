@@ -0,0 +1,31 @@
+#pragma once
+
+#include "animation.h"
+
+class Skeleton;
+
+// Translation and rotation tolerances are world space distances, in the units of the source clip. Joints are reduced
+// parent first and each track is measured on top of the already reduced ancestors and tracks, so at the source key
+// times every joint and a set of virtual points 'shell_distance' away from it end up at most the larger of the two
+// tolerances away from the source pose. The runtime does not apply scale, so the scale tolerance bounds the change
+// of the local scale values instead.
+struct KeyReductionSettings
+{
+	float translation_tolerance = 0.01f;
+	float rotation_tolerance = 0.01f;
+	float scale_tolerance = 0.01f;
+	float shell_distance = 10.0f;
+};
+
+struct KeyReductionReport
+{
+	uint32_t source_keys;
+	uint32_t reduced_keys;
+	float	 max_error; // Largest world space distance of the reduced clip from the source one, measured after reduction.
+	float	 max_scale_error;
+};
+
+// Removes every key that interpolation between the remaining keys can reconstruct within the given tolerances.
+// Must run on the source keys, before the clip is resampled or compressed. Animation::load() runs it on import when
+// given settings.
+extern KeyReductionReport reduce_keyframes(Animation* animation, Skeleton* skeleton, const KeyReductionSettings& settings = KeyReductionSettings());
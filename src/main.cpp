@@ -6,15 +6,20 @@
 #include <memory>
 #include <iostream>
 #include <stack>
+#include <chrono>
 #include "skeletal_mesh.h"
 #include "anim_sample.h"
 #include "anim_local_transform.h"
 #include "anim_global_transform.h"
 #include "anim_offset.h"
+#include "anim_fused_transform.h"
 #include "anim_blend.h"
 #include "blendspace_1d.h"
 #include "blendspace_2d.h"
+#include "blendspace_triangulated.h"
 #include "anim_fabrik_ik.h"
+#include "anim_update_lod.h"
+#include "keyframe_reduction.h"
 
 // Uniform buffer data structure.
 struct ObjectUniforms
@@ -36,6 +41,14 @@ struct BoneVertex
 
 #define CAMERA_FAR_PLANE 10000.0f
 
+// How the joint hierarchy is evaluated into the skinning palette.
+enum HierarchyMode
+{
+	HIERARCHY_MATRIX = 0, // AnimLocalTransform, AnimGlobalTransform and AnimOffset as separate passes.
+	HIERARCHY_FUSED,	  // AnimFusedTransform.
+	HIERARCHY_QVV		  // Rotation and translation through AnimGlobalTransform::generate_pose(), matrices only in AnimOffset.
+};
+
 class AnimationStateMachine : public dw::Application
 {
 protected:
@@ -112,7 +125,9 @@ protected:
 		glDisable(GL_CULL_FACE);
 
 		// Update Skeleton
+		auto update_start = std::chrono::high_resolution_clock::now();
 		update_animations();
+		m_animation_update_time = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - update_start).count();
 	
         // Render Mesh.
 		if (m_visualize_mesh)
@@ -340,6 +355,29 @@ private:
 		m_anim_program->uniform_block_binding("u_ObjectUBO", 1);
 		m_anim_program->uniform_block_binding("u_BoneUBO", 2);
 
+		// Create compact palette Animation shader
+		m_anim_compact_vs = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, "shader/skinning_compact_vs.glsl"));
+
+		if (!m_anim_compact_vs)
+		{
+			DW_LOG_FATAL("Failed to create Compact Animation Shader");
+			return false;
+		}
+
+		// Create compact palette Animation shader program
+		dw::gl::Shader* anim_compact_shaders[] = { m_anim_compact_vs.get(), m_anim_fs.get() };
+		m_anim_compact_program = std::make_unique<dw::gl::Program>(2, anim_compact_shaders);
+
+		if (!m_anim_compact_program)
+		{
+			DW_LOG_FATAL("Failed to create Compact Animation Shader Program");
+			return false;
+		}
+
+		m_anim_compact_program->uniform_block_binding("u_GlobalUBO", 0);
+		m_anim_compact_program->uniform_block_binding("u_ObjectUBO", 1);
+		m_anim_compact_program->uniform_block_binding("u_BoneUBO", 2);
+
 		// Create Bone shaders
 		m_bone_vs = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_VERTEX_SHADER, "shader/bone_vs.glsl"));
 		m_bone_fs = std::unique_ptr<dw::gl::Shader>(dw::gl::Shader::create_from_file(GL_FRAGMENT_SHADER, "shader/bone_fs.glsl"));
@@ -380,6 +418,9 @@ private:
         // Create uniform buffer for CSM data
 		m_bone_ubo = std::make_unique<dw::gl::UniformBuffer>(GL_DYNAMIC_DRAW, sizeof(PoseTransforms));
 
+		// Create uniform buffer for the compact 3x4 palette
+		m_compact_bone_ubo = std::make_unique<dw::gl::UniformBuffer>(GL_DYNAMIC_DRAW, sizeof(CompactTransform) * MAX_BONES);
+
 		return true;
 	}
 
@@ -387,7 +428,33 @@ private:
 
 	bool load_mesh()
 	{
-		m_skeletal_mesh = std::unique_ptr<SkeletalMesh>(SkeletalMesh::load("mesh/Rifle/Rifle_Walk_Fwd.fbx"));
+		// Prefer the baked skeleton when the baker has been run, otherwise it is built from the mesh file.
+		Skeleton* skeleton = Skeleton::load("mesh/Rifle/Rifle_Walk_Fwd.skel");
+
+		if (!skeleton)
+		{
+			skeleton = Skeleton::create("mesh/Rifle/Rifle_Walk_Fwd.fbx");
+
+			if (!skeleton)
+			{
+				DW_LOG_FATAL("Failed to load skeleton!");
+				return false;
+			}
+		}
+
+		// Bone LODs reorder the joints, so they have to be in place before the mesh and clips look joints up. LOD 1 drops
+		// the twist bones, LOD 2 the fingers and toes as well.
+		if (skeleton->num_lods() == 1)
+		{
+			std::vector<std::vector<std::string>> bone_lods = {
+				{ "upperarm_twist_01_l", "upperarm_twist_01_r", "lowerarm_twist_01_l", "lowerarm_twist_01_r", "thigh_twist_01_l", "thigh_twist_01_r", "calf_twist_01_l", "calf_twist_01_r" },
+				{ "thumb_01_l", "index_01_l", "middle_01_l", "ring_01_l", "pinky_01_l", "thumb_01_r", "index_01_r", "middle_01_r", "ring_01_r", "pinky_01_r", "ball_l", "ball_r" }
+			};
+
+			skeleton->build_lods(bone_lods);
+		}
+
+		m_skeletal_mesh = std::unique_ptr<SkeletalMesh>(SkeletalMesh::load("mesh/Rifle/Rifle_Walk_Fwd.fbx", skeleton));
 
 		if (!m_skeletal_mesh)
 		{
@@ -400,9 +467,26 @@ private:
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
 
+	// Loads the baked version of a clip (same path with an .anim extension, .additive.anim for additive clips) if it exists,
+	// and falls back to importing the source file with the default key reduction.
+	Animation* load_animation(const std::string& name, bool additive = false, Animation* additive_reference = nullptr)
+	{
+		std::string baked_name = name.substr(0, name.find_last_of('.')) + (additive ? ".additive.anim" : ".anim");
+		Animation*	animation = Animation::load_baked(baked_name, m_skeletal_mesh->skeleton());
+
+		if (animation)
+			return animation;
+
+		KeyReductionSettings reduction;
+
+		return Animation::load(name, m_skeletal_mesh->skeleton(), additive, additive_reference, 0.0f, &reduction);
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
 	bool load_animations()
 	{
-		m_walk_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/Rifle_Walk_Fwd.fbx", m_skeletal_mesh->skeleton()));
+		m_walk_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/Rifle_Walk_Fwd.fbx"));
 
 		if (!m_walk_animation)
 		{
@@ -410,7 +494,7 @@ private:
 			return false;
 		}
 
-		m_jog_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/Rifle_Run_Fwd.fbx", m_skeletal_mesh->skeleton()));
+		m_jog_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/Rifle_Run_Fwd.fbx"));
 
 		if (!m_jog_animation)
 		{
@@ -418,7 +502,7 @@ private:
 			return false;
 		}
 
-		m_run_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/Rifle_Sprint_Fwd.fbx", m_skeletal_mesh->skeleton()));
+		m_run_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/Rifle_Sprint_Fwd.fbx"));
 
 		if (!m_run_animation)
 		{
@@ -426,7 +510,7 @@ private:
 			return false;
 		}
 
-		m_additive_base_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/AimOffsets/Rifle_Aim_Fwd.fbx", m_skeletal_mesh->skeleton()));
+		m_additive_base_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/AimOffsets/Rifle_Aim_Fwd.fbx"));
 
 		if (!m_additive_base_animation)
 		{
@@ -434,7 +518,7 @@ private:
 			return false;
 		}
 
-		m_aim_lu_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/AimOffsets/Rifle_Aim_Left_Up.fbx", m_skeletal_mesh->skeleton(), true, m_additive_base_animation.get()));
+		m_aim_lu_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/AimOffsets/Rifle_Aim_Left_Up.fbx", true, m_additive_base_animation.get()));
 
 		if (!m_aim_lu_animation)
 		{
@@ -442,7 +526,7 @@ private:
 			return false;
 		}
 
-		m_aim_cu_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/AimOffsets/Rifle_Aim_Up.fbx", m_skeletal_mesh->skeleton(), true, m_additive_base_animation.get()));
+		m_aim_cu_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/AimOffsets/Rifle_Aim_Up.fbx", true, m_additive_base_animation.get()));
 
 		if (!m_aim_cu_animation)
 		{
@@ -450,7 +534,7 @@ private:
 			return false;
 		}
 
-		m_aim_ru_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/AimOffsets/Rifle_Aim_Right_Up.fbx", m_skeletal_mesh->skeleton(), true, m_additive_base_animation.get()));
+		m_aim_ru_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/AimOffsets/Rifle_Aim_Right_Up.fbx", true, m_additive_base_animation.get()));
 
 		if (!m_aim_ru_animation)
 		{
@@ -458,7 +542,7 @@ private:
 			return false;
 		}
 
-		m_aim_l_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/AimOffsets/Rifle_Aim_Left.fbx", m_skeletal_mesh->skeleton(), true, m_additive_base_animation.get()));
+		m_aim_l_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/AimOffsets/Rifle_Aim_Left.fbx", true, m_additive_base_animation.get()));
 
 		if (!m_aim_l_animation)
 		{
@@ -466,7 +550,7 @@ private:
 			return false;
 		}
 
-		m_aim_c_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/AimOffsets/Rifle_Aim_Fwd.fbx", m_skeletal_mesh->skeleton(), true, m_additive_base_animation.get()));
+		m_aim_c_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/AimOffsets/Rifle_Aim_Fwd.fbx", true, m_additive_base_animation.get()));
 
 		if (!m_aim_c_animation)
 		{
@@ -474,7 +558,7 @@ private:
 			return false;
 		}
 
-		m_aim_r_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/AimOffsets/Rifle_Aim_Right.fbx", m_skeletal_mesh->skeleton(), true, m_additive_base_animation.get()));
+		m_aim_r_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/AimOffsets/Rifle_Aim_Right.fbx", true, m_additive_base_animation.get()));
 
 		if (!m_aim_r_animation)
 		{
@@ -482,7 +566,7 @@ private:
 			return false;
 		}
 
-		m_aim_ld_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/AimOffsets/Rifle_Aim_Left_Down.fbx", m_skeletal_mesh->skeleton(), true, m_additive_base_animation.get()));
+		m_aim_ld_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/AimOffsets/Rifle_Aim_Left_Down.fbx", true, m_additive_base_animation.get()));
 
 		if (!m_aim_ld_animation)
 		{
@@ -490,7 +574,7 @@ private:
 			return false;
 		}
 
-		m_aim_cd_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/AimOffsets/Rifle_Aim_Down.fbx", m_skeletal_mesh->skeleton(), true, m_additive_base_animation.get()));
+		m_aim_cd_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/AimOffsets/Rifle_Aim_Down.fbx", true, m_additive_base_animation.get()));
 
 		if (!m_aim_cd_animation)
 		{
@@ -498,7 +582,7 @@ private:
 			return false;
 		}
 
-		m_aim_rd_animation = std::unique_ptr<Animation>(Animation::load("mesh/Rifle/AimOffsets/Rifle_Aim_Right_Down.fbx", m_skeletal_mesh->skeleton(), true, m_additive_base_animation.get()));
+		m_aim_rd_animation = std::unique_ptr<Animation>(load_animation("mesh/Rifle/AimOffsets/Rifle_Aim_Right_Down.fbx", true, m_additive_base_animation.get()));
 
 		if (!m_aim_rd_animation)
 		{
@@ -506,6 +590,10 @@ private:
 			return false;
 		}
 
+		// Joints that any of the aim offsets actually move, the additive blend leaves every other joint untouched.
+		for (Animation* animation : { m_aim_lu_animation.get(), m_aim_cu_animation.get(), m_aim_ru_animation.get(), m_aim_l_animation.get(), m_aim_c_animation.get(), m_aim_r_animation.get(), m_aim_ld_animation.get(), m_aim_cd_animation.get(), m_aim_rd_animation.get() })
+			merge_additive_joints(animation, m_aim_additive_joints);
+
 		m_walk_sampler = std::make_unique<AnimSample>(m_skeletal_mesh->skeleton(), m_walk_animation.get());
 		m_run_sampler = std::make_unique<AnimSample>(m_skeletal_mesh->skeleton(), m_run_animation.get());
 		
@@ -513,7 +601,15 @@ private:
 		m_global_transform = std::make_unique<AnimGlobalTransform>(m_skeletal_mesh->skeleton());
 		m_fabrik_ik = std::make_unique<AnimFabrikIK>(m_skeletal_mesh->skeleton());
 		m_offset = std::make_unique<AnimOffset>(m_skeletal_mesh->skeleton());
+		m_fused_transform = std::make_unique<AnimFusedTransform>(m_skeletal_mesh->skeleton());
+
+		// FABRIK rebuilds the joints below the chain from their local transforms.
+		m_fused_transform->set_keep_local_transforms(true);
 		m_blend = std::make_unique<AnimBlend>(m_skeletal_mesh->skeleton());
+		m_aim_mask = std::make_unique<BoneMask>(m_skeletal_mesh->skeleton(), "spine_01");
+		m_ik_chain = std::make_unique<IKChain>(m_skeletal_mesh->skeleton(), "clavicle_l", "hand_l");
+		m_arm_ik_chain = std::make_unique<IKChain>(m_skeletal_mesh->skeleton(), "upperarm_l", "hand_l");
+		m_update_lod = std::make_unique<AnimUpdateLOD>(m_skeletal_mesh->skeleton());
 
 		std::vector<Blendspace1D::Node*> nodes = {
 			new Blendspace1D::Node(m_skeletal_mesh->skeleton(), m_walk_animation.get(), 0.0f),
@@ -523,28 +619,20 @@ private:
 
 		m_blendspace_1d = std::make_unique<Blendspace1D>(m_skeletal_mesh->skeleton(), nodes);
 
-		std::vector<Blendspace2D::Row > rows = {
-		{ -90.0f,{
-			new Blendspace2D::Node(m_skeletal_mesh->skeleton(), m_aim_rd_animation.get(), -90.0f),
-			new Blendspace2D::Node(m_skeletal_mesh->skeleton(), m_aim_cd_animation.get(), 0.0f),
-			new Blendspace2D::Node(m_skeletal_mesh->skeleton(), m_aim_ld_animation.get(), 90.0f)
-		}
-		},
-		{ 0.0f,{
-			new Blendspace2D::Node(m_skeletal_mesh->skeleton(), m_aim_r_animation.get(), -90.0f),
-			new Blendspace2D::Node(m_skeletal_mesh->skeleton(), m_aim_c_animation.get(), 0.0f),
-			new Blendspace2D::Node(m_skeletal_mesh->skeleton(), m_aim_l_animation.get(), 90.0f)			
-		}
-		},
-		{ 90.0f,{
-			new Blendspace2D::Node(m_skeletal_mesh->skeleton(), m_aim_ru_animation.get(), -90.0f),
-			new Blendspace2D::Node(m_skeletal_mesh->skeleton(), m_aim_cu_animation.get(), 0.0f),
-			new Blendspace2D::Node(m_skeletal_mesh->skeleton(), m_aim_lu_animation.get(), 90.0f)
-		}
-		},
+		// Yaw on x, pitch on y. The samples are triangulated, so only the three around the aim direction get sampled.
+		std::vector<BlendspaceTriangulated::Node*> aim_nodes = {
+			new BlendspaceTriangulated::Node(m_skeletal_mesh->skeleton(), m_aim_rd_animation.get(), -90.0f, -90.0f),
+			new BlendspaceTriangulated::Node(m_skeletal_mesh->skeleton(), m_aim_cd_animation.get(), 0.0f, -90.0f),
+			new BlendspaceTriangulated::Node(m_skeletal_mesh->skeleton(), m_aim_ld_animation.get(), 90.0f, -90.0f),
+			new BlendspaceTriangulated::Node(m_skeletal_mesh->skeleton(), m_aim_r_animation.get(), -90.0f, 0.0f),
+			new BlendspaceTriangulated::Node(m_skeletal_mesh->skeleton(), m_aim_c_animation.get(), 0.0f, 0.0f),
+			new BlendspaceTriangulated::Node(m_skeletal_mesh->skeleton(), m_aim_l_animation.get(), 90.0f, 0.0f),
+			new BlendspaceTriangulated::Node(m_skeletal_mesh->skeleton(), m_aim_ru_animation.get(), -90.0f, 90.0f),
+			new BlendspaceTriangulated::Node(m_skeletal_mesh->skeleton(), m_aim_cu_animation.get(), 0.0f, 90.0f),
+			new BlendspaceTriangulated::Node(m_skeletal_mesh->skeleton(), m_aim_lu_animation.get(), 90.0f, 90.0f)
 		};
 
-		m_blendspace_2d = std::make_unique<Blendspace2D>(m_skeletal_mesh->skeleton(), rows);
+		m_blendspace_2d = std::make_unique<BlendspaceTriangulated>(m_skeletal_mesh->skeleton(), aim_nodes);
 
 		return true;
 	}
@@ -583,7 +671,11 @@ private:
 	{
 		// Bind uniform buffers.
 		m_object_ubo->bind_base(1);
-		m_bone_ubo->bind_base(2);
+
+		if (m_compact_palette)
+			m_compact_bone_ubo->bind_base(2);
+		else
+			m_bone_ubo->bind_base(2);
 
 		// Bind vertex array.
 		mesh->bind_vao();
@@ -606,7 +698,10 @@ private:
 	void render_skeletal_meshes()
 	{
 		// Bind shader program.
-		m_anim_program->use();
+		if (m_compact_palette)
+			m_anim_compact_program->use();
+		else
+			m_anim_program->use();
 
 		// Bind uniform buffers.
 		m_global_ubo->bind_base(0);
@@ -641,6 +736,29 @@ private:
 		memcpy(ptr, bones, sizeof(PoseTransforms));
 		m_bone_ubo->unmap();
 	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void update_bone_uniforms(CompactPoseTransforms* bones)
+	{
+		// Only the entries used by the skeleton are uploaded.
+		void* ptr = m_compact_bone_ubo->map(GL_WRITE_ONLY);
+		memcpy(ptr, &bones->transforms[0], sizeof(CompactTransform) * bones->num_transforms);
+		m_compact_bone_ubo->unmap();
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void upload_palette(PoseTransforms* palette)
+	{
+		if (m_compact_palette)
+		{
+			pack_transforms(palette, m_skeletal_mesh->skeleton()->num_bones(), &m_compact_pose_transforms);
+			update_bone_uniforms(&m_compact_pose_transforms);
+		}
+		else
+			update_bone_uniforms(palette);
+	}
     
     // -----------------------------------------------------------------------------------------------------------------------------------
     
@@ -708,28 +826,92 @@ private:
 
 	void update_animations()
 	{
-		Pose* locomotion_pose = m_blendspace_1d->evaluate(m_delta_seconds);
-		Pose* aim_pose = m_blendspace_2d->evaluate(m_delta_seconds);
-		Pose* final_pose = m_blend->blend_partial_additive(locomotion_pose, aim_pose, m_additive_blend_factor, "spine_01");
+		// Frames skipped by the update-rate LOD only blend the last two evaluated palettes.
+		if (!m_update_lod->update(m_delta_seconds))
+		{
+			upload_palette(m_update_lod->palette());
+			return;
+		}
+
+		float dt = m_update_lod->elapsed();
 
-		PoseTransforms* local_transforms = m_local_transform->generate_transforms(final_pose);
-		PoseTransforms* global_transforms = m_global_transform->generate_transforms(local_transforms);
+		// Sample counters cover a single update, see the UI.
+		m_blendspace_1d->reset_counters();
+		m_blendspace_2d->reset_counters();
 
-		if (!m_ik_pos_set)
+		const Pose* locomotion_pose = m_blendspace_1d->evaluate(dt);
+		const Pose* final_pose = locomotion_pose;
+
+		// The aim layer is only evaluated while it contributes; otherwise its clips just keep time.
+		if (m_additive_blend_factor < BLEND_WEIGHT_EPSILON)
+			m_blendspace_2d->advance(dt);
+		else
 		{
-			m_ik_pos_set = true;
-			int32_t hand_idx = m_skeletal_mesh->skeleton()->find_joint_index("hand_l");
+			const Pose* aim_pose = m_blendspace_2d->evaluate(dt);
+			final_pose = m_blend->blend_partial_additive(locomotion_pose, aim_pose, m_additive_blend_factor, *m_aim_mask, m_aim_additive_joints);
+		}
 
-			glm::mat4 m = m_character_transforms.model * global_transforms->transforms[hand_idx];
+		PoseTransforms* final_transforms = nullptr;
+
+		if (m_hierarchy_mode == HIERARCHY_QVV)
+		{
+			Pose* global_pose = m_global_transform->generate_pose(final_pose);
 
-			m_ik_pos = glm::vec3(m[3][0], m[3][1], m[3][2]);
+			if (!m_ik_pos_set)
+			{
+				m_ik_pos_set = true;
+				int32_t hand_idx = m_skeletal_mesh->skeleton()->find_joint_index("hand_l");
+
+				m_ik_pos = glm::vec3(m_character_transforms.model * glm::vec4(global_pose->keyframes[hand_idx].translation, 1.0f));
+			}
+
+			Pose* ik_pose = m_fabrik_ik->solve(m_character_transforms.model, final_pose, global_pose, m_ik_pos, m_two_bone_arm_ik ? *m_arm_ik_chain : *m_ik_chain);
+			final_transforms = m_offset->offset(ik_pose);
+
+			update_skeleton_debug(m_skeletal_mesh->skeleton(), ik_pose);
 		}
-		
-		PoseTransforms* ik_transforms = m_fabrik_ik->solve(m_character_transforms.model, local_transforms, global_transforms, m_ik_pos, "clavicle_l", "hand_l");
-		PoseTransforms* final_transforms = m_offset->offset(ik_transforms);
+		else
+		{
+			PoseTransforms* local_transforms = nullptr;
+			PoseTransforms* global_transforms = nullptr;
+
+			if (m_hierarchy_mode == HIERARCHY_FUSED)
+			{
+				m_fused_transform->generate_transforms(final_pose);
+
+				local_transforms = m_fused_transform->local_transforms();
+				global_transforms = m_fused_transform->global_transforms();
+			}
+			else
+			{
+				local_transforms = m_local_transform->generate_transforms(final_pose);
+				global_transforms = m_global_transform->generate_transforms(local_transforms);
+			}
+
+			if (!m_ik_pos_set)
+			{
+				m_ik_pos_set = true;
+				int32_t hand_idx = m_skeletal_mesh->skeleton()->find_joint_index("hand_l");
+
+				glm::mat4 m = m_character_transforms.model * global_transforms->transforms[hand_idx];
+
+				m_ik_pos = glm::vec3(m[3][0], m[3][1], m[3][2]);
+			}
 
-		update_bone_uniforms(final_transforms);
-		update_skeleton_debug(m_skeletal_mesh->skeleton(), ik_transforms);
+			PoseTransforms* ik_transforms = m_fabrik_ik->solve(m_character_transforms.model, local_transforms, global_transforms, m_ik_pos, m_two_bone_arm_ik ? *m_arm_ik_chain : *m_ik_chain);
+
+			// The fused palette is already up to date for every joint before the IK chain.
+			if (m_hierarchy_mode == HIERARCHY_FUSED)
+				final_transforms = m_fused_transform->update_palette(ik_transforms, m_fabrik_ik->first_modified_joint());
+			else
+				final_transforms = m_offset->offset(ik_transforms);
+
+			update_skeleton_debug(m_skeletal_mesh->skeleton(), ik_transforms);
+		}
+
+		m_update_lod->store(final_transforms);
+
+		upload_palette(m_update_lod->palette());
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
@@ -738,18 +920,30 @@ private:
 	{
 		m_joint_pos.clear();
 
-		Joint* joints = skeleton->joints();
+		for (uint32_t i = 0; i < skeleton->num_bones(); i++)
+			add_skeleton_debug_joint(transforms->transforms[i]);
+	}
 
-		for (int i = 0; i < skeleton->num_bones(); i++)
-		{
-			glm::mat4 joint = joints[i].offset_transform;
-			glm::mat4 mat = m_character_transforms.model * transforms->transforms[i];
+	// -----------------------------------------------------------------------------------------------------------------------------------
 
-			m_joint_pos.push_back(glm::vec3(mat[3][0], mat[3][1], mat[3][2]));
+	void update_skeleton_debug(Skeleton* skeleton, Pose* global_pose)
+	{
+		m_joint_pos.clear();
 
-			if (m_visualize_axis)
-				m_debug_draw.transform(mat);
-		}
+		for (uint32_t i = 0; i < skeleton->num_bones(); i++)
+			add_skeleton_debug_joint(keyframe_matrix(global_pose->keyframes[i]));
+	}
+
+	// -----------------------------------------------------------------------------------------------------------------------------------
+
+	void add_skeleton_debug_joint(const glm::mat4& transform)
+	{
+		glm::mat4 mat = m_character_transforms.model * transform;
+
+		m_joint_pos.push_back(glm::vec3(mat[3][0], mat[3][1], mat[3][2]));
+
+		if (m_visualize_axis)
+			m_debug_draw.transform(mat);
 	}
 
 	// -----------------------------------------------------------------------------------------------------------------------------------
@@ -799,6 +993,66 @@ private:
 		ImGui::Checkbox("Visualize Bone Axis", &m_visualize_axis);
 		ImGui::SliderFloat("IK Target", &m_ik_pos.y, 5.0f, 20.0f);
 
+		ImGui::Text("Animation Update: %.2f us", m_animation_update_time);
+
+		if (ImGui::Checkbox("SIMD Sampling", &m_simd_sampling))
+		{
+			m_blendspace_1d->set_simd(m_simd_sampling);
+			m_blendspace_2d->set_simd(m_simd_sampling);
+		}
+
+		const char* hierarchy_modes[] = { "Matrix", "Fused", "QVV" };
+		ImGui::Combo("Hierarchy", &m_hierarchy_mode, hierarchy_modes, 3);
+		ImGui::Checkbox("Compact Palette", &m_compact_palette);
+
+		// The two-bone arm chain is solved in closed form, the clavicle chain with FABRIK.
+		ImGui::Checkbox("Two Bone Arm IK", &m_two_bone_arm_ik);
+
+		if (ImGui::Checkbox("IK Warm Start", &m_ik_warm_start))
+			m_fabrik_ik->set_warm_start(m_ik_warm_start);
+
+		ImGui::Text("IK Iterations: %u, Residual: %f", m_fabrik_ik->iterations_used(), m_fabrik_ik->residual());
+
+		if (ImGui::Checkbox("SIMD Blending", &m_simd_blending))
+		{
+			m_blendspace_1d->set_simd_blending(m_simd_blending);
+			m_blendspace_2d->set_simd_blending(m_simd_blending);
+			m_blend->set_simd(m_simd_blending);
+		}
+
+		if (ImGui::Checkbox("SIMD Hierarchy", &m_simd_hierarchy))
+			m_global_transform->set_simd(m_simd_hierarchy);
+
+		if (ImGui::SliderInt("Bone LOD", &m_bone_lod, 0, m_skeletal_mesh->skeleton()->num_lods() - 1))
+		{
+			m_blendspace_1d->set_lod(m_bone_lod);
+			m_blendspace_2d->set_lod(m_bone_lod);
+			m_global_transform->set_lod(m_bone_lod);
+			m_offset->set_lod(m_bone_lod);
+			m_fused_transform->set_lod(m_bone_lod);
+		}
+
+		int update_interval = m_update_lod->interval();
+
+		if (ImGui::SliderInt("Update Interval", &update_interval, 1, 8))
+			m_update_lod->set_interval(update_interval);
+
+		if (ImGui::Checkbox("Extrapolate Skipped Frames", &m_extrapolate_skipped_frames))
+			m_update_lod->set_mode(m_extrapolate_skipped_frames ? UPDATE_LOD_EXTRAPOLATE : UPDATE_LOD_INTERPOLATE);
+
+		uint64_t evaluated_samples = m_blendspace_1d->evaluated_samples() + m_blendspace_2d->evaluated_samples();
+		uint64_t skipped_samples = m_blendspace_1d->skipped_samples() + m_blendspace_2d->skipped_samples();
+
+		ImGui::Text("Samples Evaluated: %llu, Skipped: %llu (last update)", (unsigned long long)evaluated_samples, (unsigned long long)skipped_samples);
+
+		if (ImGui::Checkbox("NLerp Rotations", &m_nlerp_rotations))
+		{
+			RotationInterpolation mode = m_nlerp_rotations ? ROTATION_INTERPOLATION_NLERP : ROTATION_INTERPOLATION_SLERP;
+
+			m_blendspace_1d->set_rotation_interpolation(mode);
+			m_blendspace_2d->set_rotation_interpolation(mode);
+		}
+
 		float rate = m_walk_sampler->playback_rate();
 		ImGui::SliderFloat("Playback Rate", &rate, 0.1f, 1.0f);
 		m_walk_sampler->set_playback_rate(rate);
@@ -881,12 +1135,15 @@ private:
 	std::unique_ptr<dw::gl::Program> m_program;
 	std::unique_ptr<dw::gl::UniformBuffer> m_object_ubo;
     std::unique_ptr<dw::gl::UniformBuffer> m_bone_ubo;
+	std::unique_ptr<dw::gl::UniformBuffer> m_compact_bone_ubo;
     std::unique_ptr<dw::gl::UniformBuffer> m_global_ubo;
     
     // Animation shaders.
     std::unique_ptr<dw::gl::Shader> m_anim_vs;
     std::unique_ptr<dw::gl::Shader> m_anim_fs;
     std::unique_ptr<dw::gl::Program> m_anim_program;
+	std::unique_ptr<dw::gl::Shader> m_anim_compact_vs;
+	std::unique_ptr<dw::gl::Program> m_anim_compact_program;
 
 	// Bone shaders.
 	std::unique_ptr<dw::gl::Shader> m_bone_vs;
@@ -902,6 +1159,7 @@ private:
     ObjectUniforms m_character_transforms;
     GlobalUniforms m_global_uniforms;
 	PoseTransforms m_pose_transforms;
+	CompactPoseTransforms m_compact_pose_transforms;
 
 	// Animations
 	std::unique_ptr<Animation> m_walk_animation;
@@ -914,7 +1172,9 @@ private:
 	std::unique_ptr<AnimGlobalTransform> m_global_transform;
 	std::unique_ptr<AnimFabrikIK> m_fabrik_ik;
 	std::unique_ptr<AnimOffset> m_offset;
+	std::unique_ptr<AnimFusedTransform> m_fused_transform;
 	std::unique_ptr<AnimBlend> m_blend;
+	std::unique_ptr<AnimUpdateLOD> m_update_lod;
 	std::unique_ptr<Blendspace1D> m_blendspace_1d;
 
 	std::unique_ptr<Animation> m_aim_lu_animation;
@@ -926,7 +1186,11 @@ private:
 	std::unique_ptr<Animation> m_aim_ld_animation;
 	std::unique_ptr<Animation> m_aim_cd_animation;
 	std::unique_ptr<Animation> m_aim_rd_animation;
-	std::unique_ptr<Blendspace2D> m_blendspace_2d;
+	std::vector<uint32_t> m_aim_additive_joints;
+	std::unique_ptr<BoneMask> m_aim_mask;
+	std::unique_ptr<IKChain> m_ik_chain;
+	std::unique_ptr<IKChain> m_arm_ik_chain;
+	std::unique_ptr<BlendspaceTriangulated> m_blendspace_2d;
 
 	// Mesh
 	std::unique_ptr<SkeletalMesh> m_skeletal_mesh;
@@ -949,6 +1213,17 @@ private:
 	bool m_visualize_joints = false;
 	bool m_visualize_bones = false;
 	bool m_visualize_axis = false;
+	bool m_simd_sampling = false;
+	bool m_simd_blending = false;
+	bool m_simd_hierarchy = false;
+	int m_hierarchy_mode = HIERARCHY_FUSED;
+	bool m_compact_palette = false;
+	bool m_two_bone_arm_ik = false;
+	bool m_ik_warm_start = false;
+	bool m_nlerp_rotations = false;
+	bool m_extrapolate_skipped_frames = false;
+	int m_bone_lod = 0;
+	float m_animation_update_time = 0.0f;
 
 	// Camera orientation.
 	float m_camera_x;
@@ -0,0 +1,84 @@
+#include "pose_cache.h"
+#include <cmath>
+#include <algorithm>
+
+PoseCache::PoseCache(Skeleton* skeleton, float time_step) : m_skeleton(skeleton), m_time_step(time_step)
+{
+
+}
+
+PoseCache::~PoseCache()
+{
+
+}
+
+void PoseCache::new_frame()
+{
+	m_poses.clear();
+	m_pool_used = 0;
+}
+
+const Pose* PoseCache::sample(Animation* animation, double local_time, RotationInterpolation mode, bool simd, uint32_t lod)
+{
+	// Wrap first so that instances on different loops of the clip still share a key.
+	double duration = animation->duration_in_ticks / (animation->ticks_per_second != 0 ? animation->ticks_per_second : 25.0);
+	double wrapped_time = fmod(local_time, duration);
+
+	if (wrapped_time < 0.0)
+		wrapped_time += duration;
+
+	// Rounded to the nearest step, but never up to the end of the clip which would wrap around to its first pose.
+	int64_t last_step = std::max(static_cast<int64_t>(std::ceil(duration / m_time_step)) - 1, int64_t(0));
+	Key key = { animation, std::min(static_cast<int64_t>(std::floor(wrapped_time / m_time_step + 0.5)), last_step), mode, simd, lod };
+	auto it = m_poses.find(key);
+
+	if (it != m_poses.end())
+	{
+		m_hits++;
+		return it->second;
+	}
+
+	m_misses++;
+
+	if (m_pool_used == m_pool.size())
+		m_pool.push_back(std::make_unique<Pose>());
+
+	Pose* pose = m_pool[m_pool_used++].get();
+
+	std::unique_ptr<AnimBatchSample>& sampler = m_samplers[animation];
+
+	if (!sampler)
+		sampler = std::make_unique<AnimBatchSample>(m_skeleton, animation);
+
+	// One sampler per clip is shared by all settings, they are part of the key.
+	sampler->set_rotation_interpolation(mode);
+	sampler->set_simd(simd);
+	sampler->set_lod(lod);
+
+	double quantized_time = key.step * (double)m_time_step;
+	sampler->sample(&quantized_time, 1, pose);
+
+	m_poses[key] = pose;
+
+	return pose;
+}
+
+void PoseCache::set_time_step(float step)
+{
+	if (step <= 0.0f)
+		return;
+
+	m_time_step = step;
+	new_frame();
+}
+
+float PoseCache::time_step()
+{
+	return m_time_step;
+}
+
+void PoseCache::reset_counters()
+{
+	m_hits = 0;
+	m_misses = 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "anim_batch_sample.h"
+#include <unordered_map>
+#include <memory>
+
+// Poses of clips sampled at quantized local times, shared between every instance playing the same clip at the same
+// (quantized) phase. Each clip and time step is sampled at most once per frame; every other request is a hit.
+class PoseCache
+{
+public:
+	// 'time_step' is the quantization step in seconds. Larger steps give more hits at the cost of accuracy.
+	PoseCache(Skeleton* skeleton, float time_step = 1.0f / 60.0f);
+	~PoseCache();
+
+	// Releases the poses of the previous frame. Call once per frame before sampling.
+	void new_frame();
+
+	// Pose of the clip at the quantized 'local_time' in seconds, sampled with the given settings. Only requests with the
+	// same settings share a pose. The pose must not be modified, it stays valid until the next call to new_frame().
+	const Pose* sample(Animation* animation, double local_time, RotationInterpolation mode, bool simd, uint32_t lod);
+
+	void set_time_step(float step);
+	float time_step();
+	inline uint64_t hits() { return m_hits; }
+	inline uint64_t misses() { return m_misses; }
+	void reset_counters();
+
+private:
+	struct Key
+	{
+		Animation*			  animation;
+		int64_t				  step;
+		RotationInterpolation mode;
+		bool				  simd;
+		uint32_t			  lod;
+
+		bool operator==(const Key& other) const { return animation == other.animation && step == other.step && mode == other.mode && simd == other.simd && lod == other.lod; }
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			size_t settings = (key.lod << 8) | (key.mode << 1) | (key.simd ? 1 : 0);
+			return std::hash<Animation*>()(key.animation) ^ (std::hash<int64_t>()(key.step) * 31) ^ (settings * 131);
+		}
+	};
+
+private:
+	Skeleton*											   m_skeleton;
+	float												   m_time_step;
+	uint64_t											   m_hits = 0;
+	uint64_t											   m_misses = 0;
+	std::unordered_map<Key, Pose*, KeyHash>				   m_poses;
+	std::unordered_map<Animation*, std::unique_ptr<AnimBatchSample>> m_samplers;
+	std::vector<std::unique_ptr<Pose>>					   m_pool; // Poses are reused from frame to frame.
+	uint32_t											   m_pool_used = 0;
+};
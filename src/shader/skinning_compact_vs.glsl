@@ -0,0 +1,58 @@
+layout (location = 0) in vec3 VS_IN_Position;
+layout (location = 1) in vec2 VS_IN_Texcoord;
+layout (location = 2) in vec3 VS_IN_Normal;
+layout (location = 3) in vec3 VS_IN_Tangent;
+layout (location = 4) in ivec4 VS_IN_BoneIDs;
+layout (location = 5) in vec4 VS_IN_Weights;
+
+const int MAX_BONES = 128;
+
+layout (std140) uniform u_GlobalUBO
+{ 
+    mat4 view;
+    mat4 projection;
+};
+
+layout (std140) uniform u_ObjectUBO
+{ 
+    mat4 model;
+};
+
+// Compact palette: the first three rows of every bone matrix, the bottom row is always (0, 0, 0, 1).
+layout (std140) uniform u_BoneUBO
+{ 
+    vec4 bones[MAX_BONES * 3];
+};
+
+out vec3 PS_IN_FragPos;
+out vec3 PS_IN_Normal;
+
+void main()
+{
+	vec4 row_0 = vec4(0.0);
+	vec4 row_1 = vec4(0.0);
+	vec4 row_2 = vec4(0.0);
+
+	for (int i = 0; i < 4; i++)
+	{
+		int idx = VS_IN_BoneIDs[i] * 3;
+
+		row_0 += bones[idx] * VS_IN_Weights[i];
+		row_1 += bones[idx + 1] * VS_IN_Weights[i];
+		row_2 += bones[idx + 2] * VS_IN_Weights[i];
+	}
+
+	mat4 bone_transform = transpose(mat4(row_0, row_1, row_2, vec4(0.0, 0.0, 0.0, 1.0)));
+
+    mat4 model_mat = model * bone_transform;
+    vec4 position = vec4(VS_IN_Position, 1.0f);
+
+    vec4 world_pos = model_mat * position;
+    PS_IN_FragPos = world_pos.xyz;
+
+	mat3 model_bone_bat = mat3(model_mat);
+
+	PS_IN_Normal = normalize(model_bone_bat * VS_IN_Normal);
+
+	gl_Position = projection * view * world_pos;
+}
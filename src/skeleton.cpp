@@ -1,10 +1,13 @@
 #include "skeleton.h"
+#include "binary_io.h"
+#include <logger.h>
 #include <gtc/type_ptr.hpp>
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
 #include <iostream>
+#include <algorithm>
 
 void print_scene_heirarchy(aiNode* node)
 {
@@ -42,6 +45,88 @@ Skeleton* Skeleton::create(const aiScene* scene)
 
 	std::cout << "\nEnd Print Joint List\n" << std::endl;
 
+	skeleton->build_levels();
+	skeleton->build_subtrees();
+
+	return skeleton;
+}
+
+Skeleton* Skeleton::create(const std::string& name)
+{
+	Assimp::Importer importer;
+	const aiScene*	 scene = importer.ReadFile(name, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
+
+	if (!scene)
+	{
+		DW_LOG_ERROR("Failed to load skeleton from file : " + name);
+		return nullptr;
+	}
+
+	return create(scene);
+}
+
+Skeleton* Skeleton::load(const std::string& path)
+{
+	std::ifstream stream(path, std::ios::in | std::ios::binary);
+
+	if (!stream.is_open())
+		return nullptr;
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+
+	if (!read_value(stream, magic) || !read_value(stream, version) || magic != BAKED_SKELETON_MAGIC || version != BAKED_SKELETON_VERSION)
+	{
+		DW_LOG_ERROR("Unsupported baked skeleton : " + path);
+		return nullptr;
+	}
+
+	Skeleton* skeleton = new Skeleton();
+
+	if (!read_value(stream, skeleton->m_num_joints) || skeleton->m_num_joints > MAX_BONES)
+	{
+		DW_LOG_ERROR("Baked skeleton exceeds MAX_BONES : " + path);
+		delete skeleton;
+		return nullptr;
+	}
+
+	skeleton->m_joints.resize(skeleton->m_num_joints);
+
+	for (uint32_t i = 0; i < skeleton->m_num_joints; i++)
+	{
+		Joint& joint = skeleton->m_joints[i];
+
+		read_string(stream, joint.name);
+		read_value(stream, joint.offset_transform);
+		read_value(stream, joint.parent_index);
+
+		// Every pass over the joints relies on parents coming before their children.
+		if (joint.parent_index < -1 || joint.parent_index >= int32_t(i))
+		{
+			DW_LOG_ERROR("Baked skeleton has an invalid parent index : " + path);
+			delete skeleton;
+			return nullptr;
+		}
+	}
+
+	read_vector(stream, skeleton->m_lod_joint_counts);
+
+	for (uint32_t count : skeleton->m_lod_joint_counts)
+	{
+		if (count > skeleton->m_num_joints)
+			stream.setstate(std::ios::failbit);
+	}
+
+	if (!stream.good())
+	{
+		DW_LOG_ERROR("Failed to read baked skeleton : " + path);
+		delete skeleton;
+		return nullptr;
+	}
+
+	skeleton->build_levels();
+	skeleton->build_subtrees();
+
 	return skeleton;
 }
 
@@ -129,4 +214,203 @@ int32_t Skeleton::find_joint_index(const std::string& channel_name)
 	}
 
 	return -1;
+}
+
+void Skeleton::build_lods(const std::vector<std::vector<std::string>>& culled_joints)
+{
+	uint32_t			  num_lods = culled_joints.size() + 1;
+	std::vector<uint32_t> last_lod(m_num_joints, num_lods - 1);
+
+	// Last LOD at which each joint is still evaluated.
+	for (uint32_t lod = 0; lod < culled_joints.size(); lod++)
+	{
+		for (const auto& name : culled_joints[lod])
+		{
+			int32_t root = find_joint_index(name);
+
+			if (root == -1)
+			{
+				DW_LOG_ERROR("Unknown joint in bone LOD : " + name);
+				continue;
+			}
+
+			for (uint32_t i = root; i < m_num_joints; i++)
+			{
+				int32_t parent = i;
+
+				while (parent > root)
+					parent = m_joints[parent].parent_index;
+
+				if (parent == root)
+					last_lod[i] = std::min(last_lod[i], lod);
+			}
+		}
+	}
+
+	// A joint is never evaluated at more LODs than its parent, so sorting by LOD keeps parents first.
+	for (uint32_t i = 0; i < m_num_joints; i++)
+	{
+		if (m_joints[i].parent_index != -1)
+			last_lod[i] = std::min(last_lod[i], last_lod[m_joints[i].parent_index]);
+	}
+
+	std::vector<uint32_t> order(m_num_joints);
+
+	for (uint32_t i = 0; i < m_num_joints; i++)
+		order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), [&last_lod](uint32_t a, uint32_t b) { return last_lod[a] > last_lod[b]; });
+
+	std::vector<int32_t> new_index(m_num_joints);
+	std::vector<Joint>	 joints(m_num_joints);
+
+	for (uint32_t i = 0; i < m_num_joints; i++)
+		new_index[order[i]] = i;
+
+	for (uint32_t i = 0; i < m_num_joints; i++)
+	{
+		joints[i] = m_joints[order[i]];
+
+		if (joints[i].parent_index != -1)
+			joints[i].parent_index = new_index[joints[i].parent_index];
+	}
+
+	m_joints.swap(joints);
+	m_lod_joint_counts.assign(num_lods, 0);
+
+	for (uint32_t i = 0; i < m_num_joints; i++)
+	{
+		for (uint32_t lod = 0; lod <= last_lod[i]; lod++)
+			m_lod_joint_counts[lod]++;
+	}
+
+	build_levels();
+	build_subtrees();
+}
+
+uint32_t Skeleton::num_level_joints(uint32_t level, uint32_t lod)
+{
+	const uint32_t* begin = level_joints(level);
+	const uint32_t* end = &m_level_joints[0] + m_level_offsets[level + 1];
+
+	return std::lower_bound(begin, end, num_bones(lod)) - begin;
+}
+
+void Skeleton::build_levels()
+{
+	std::vector<uint32_t> depth(m_num_joints, 0);
+	uint32_t			  num_levels = 0;
+
+	// Parents come before their children, so a single pass finds every depth.
+	for (uint32_t i = 0; i < m_num_joints; i++)
+	{
+		if (m_joints[i].parent_index != -1)
+			depth[i] = depth[m_joints[i].parent_index] + 1;
+
+		num_levels = std::max(num_levels, depth[i] + 1);
+	}
+
+	m_level_offsets.assign(num_levels + 1, 0);
+
+	for (uint32_t i = 0; i < m_num_joints; i++)
+		m_level_offsets[depth[i] + 1]++;
+
+	for (uint32_t level = 0; level < num_levels; level++)
+		m_level_offsets[level + 1] += m_level_offsets[level];
+
+	// Counting sort by depth, stable so each level stays sorted by index.
+	std::vector<uint32_t> next(m_level_offsets.begin(), m_level_offsets.end() - 1);
+
+	m_level_joints.resize(m_num_joints);
+
+	for (uint32_t i = 0; i < m_num_joints; i++)
+		m_level_joints[next[depth[i]]++] = i;
+}
+
+void Skeleton::build_subtrees()
+{
+	std::vector<uint32_t> subtree_size(m_num_joints, 1);
+
+	// Children come after their parents, so a reverse pass accumulates complete subtrees.
+	for (uint32_t i = m_num_joints; i-- > 0;)
+	{
+		if (m_joints[i].parent_index != -1)
+			subtree_size[m_joints[i].parent_index] += subtree_size[i];
+	}
+
+	m_subtree_joints.resize(m_num_joints);
+	m_subtree_begins.resize(m_num_joints);
+	m_subtree_ends.resize(m_num_joints);
+
+	// A joint's first child is placed right after it, every further child after the subtree of the previous one.
+	std::vector<uint32_t> next_child(m_num_joints);
+	uint32_t			  next_root = 0;
+
+	for (uint32_t i = 0; i < m_num_joints; i++)
+	{
+		int32_t parent = m_joints[i].parent_index;
+
+		if (parent == -1)
+		{
+			m_subtree_begins[i] = next_root;
+			next_root += subtree_size[i];
+		}
+		else
+		{
+			m_subtree_begins[i] = next_child[parent];
+			next_child[parent] += subtree_size[i];
+		}
+
+		next_child[i] = m_subtree_begins[i] + 1;
+		m_subtree_ends[i] = m_subtree_begins[i] + subtree_size[i];
+		m_subtree_joints[m_subtree_begins[i]] = i;
+	}
+}
+
+bool Skeleton::save(const std::string& path)
+{
+	std::ofstream stream(path, std::ios::out | std::ios::binary);
+
+	if (!stream.is_open())
+	{
+		DW_LOG_ERROR("Failed to open file for writing : " + path);
+		return false;
+	}
+
+	write_value(stream, (uint32_t)BAKED_SKELETON_MAGIC);
+	write_value(stream, (uint32_t)BAKED_SKELETON_VERSION);
+	write_value(stream, m_num_joints);
+
+	for (const auto& joint : m_joints)
+	{
+		write_string(stream, joint.name);
+		write_value(stream, joint.offset_transform);
+		write_value(stream, joint.parent_index);
+	}
+
+	write_vector(stream, m_lod_joint_counts);
+
+	return stream.good();
+}
+
+uint64_t Skeleton::hash()
+{
+	// FNV-1a over every joint name and parent index.
+	uint64_t hash = 14695981039346656037ull;
+
+	auto combine = [&hash](const char* data, size_t size) {
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= static_cast<uint8_t>(data[i]);
+			hash *= 1099511628211ull;
+		}
+	};
+
+	for (const auto& joint : m_joints)
+	{
+		combine(joint.name.c_str(), joint.name.size() + 1);
+		combine(reinterpret_cast<const char*>(&joint.parent_index), sizeof(joint.parent_index));
+	}
+
+	return hash;
 }
\ No newline at end of file
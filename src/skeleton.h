@@ -3,6 +3,9 @@
 #include "animation.h"
 #include <unordered_set>
 
+#define BAKED_SKELETON_MAGIC 0x4C4B5341 // 'ASKL'
+#define BAKED_SKELETON_VERSION 2
+
 struct aiNode;
 struct aiBone;
 struct aiScene;
@@ -19,18 +22,55 @@ class Skeleton
 public:
 	static Skeleton* create(const aiScene* scene);
 
+	// Imports the file with Assimp and builds the skeleton of its meshes.
+	static Skeleton* create(const std::string& name);
+
+	// Loads a skeleton written by save(). Returns nullptr if the file is missing or was baked by another version.
+	static Skeleton* load(const std::string& path);
+
 	Skeleton();
 	~Skeleton();
 	int32_t find_joint_index(const std::string& channel_name);
+	bool save(const std::string& path);
+
+	// Defines bone LODs. The joints in 'culled_joints[k]' and everything below them stop being evaluated from LOD k + 1
+	// onwards, LOD 0 always evaluates every joint. Joints are reordered so that each LOD is a prefix of the joint list with
+	// parents still before their children, which changes joint indices: call this before loading meshes or clips.
+	void build_lods(const std::vector<std::vector<std::string>>& culled_joints);
+
+	// Identifies the joint names and hierarchy, used to check that a baked animation targets this skeleton.
+	uint64_t hash();
 
 	inline uint32_t num_bones() { return m_num_joints; }
+	inline uint32_t num_bones(uint32_t lod) { return m_lod_joint_counts.empty() ? m_num_joints : m_lod_joint_counts[std::min(lod, num_lods() - 1)]; }
+	inline uint32_t num_lods() { return m_lod_joint_counts.empty() ? 1 : m_lod_joint_counts.size(); }
 	inline Joint* joints() { return &m_joints[0]; }
 
+	// Joints grouped by depth in the hierarchy. Joints of a level only depend on earlier levels, so they can be composed
+	// together. Within a level joints are sorted by index, so the first 'num_level_joints(level, lod)' are inside the LOD.
+	inline uint32_t num_levels() { return m_level_offsets.empty() ? 0 : m_level_offsets.size() - 1; }
+	inline const uint32_t* level_joints(uint32_t level) { return &m_level_joints[m_level_offsets[level]]; }
+	uint32_t num_level_joints(uint32_t level, uint32_t lod);
+
+	// Joints in depth-first order, where every joint is directly followed by all of its descendants. The descendants of
+	// joint j are subtree_joints()[subtree_begin(j) + 1] up to subtree_joints()[subtree_end(j) - 1], parents first.
+	inline const uint32_t* subtree_joints() { return &m_subtree_joints[0]; }
+	inline uint32_t subtree_begin(uint32_t joint) { return m_subtree_begins[joint]; }
+	inline uint32_t subtree_end(uint32_t joint) { return m_subtree_ends[joint]; }
+
 private:
+	void build_levels();
+	void build_subtrees();
 	void build_bone_list(aiNode* node, const aiScene* scene, std::vector<aiBone*>& temp_bone_list, std::unordered_set<std::string>& bone_map);
 	void build_skeleton(aiNode* node, int bone_index, const aiScene* scene, std::vector<aiBone*>& temp_bone_list);
 
 private:
 	uint32_t		   m_num_joints;
 	std::vector<Joint> m_joints;
+	std::vector<uint32_t> m_lod_joint_counts; // Number of joints evaluated at each LOD.
+	std::vector<uint32_t> m_level_joints; // Joint indices sorted by depth, then index.
+	std::vector<uint32_t> m_level_offsets; // Start of each level in m_level_joints, plus the end of the last one.
+	std::vector<uint32_t> m_subtree_joints; // Joint indices in depth-first order.
+	std::vector<uint32_t> m_subtree_begins; // Position of each joint in m_subtree_joints.
+	std::vector<uint32_t> m_subtree_ends; // End of each joint's subtree in m_subtree_joints.
 };
\ No newline at end of file
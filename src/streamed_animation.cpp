@@ -0,0 +1,186 @@
+#include "streamed_animation.h"
+#include "skeleton.h"
+#include "binary_io.h"
+#include <logger.h>
+#include <cstring>
+
+bool StreamedAnimation::bake(const std::string& path, Animation* animation, Skeleton* skeleton, uint32_t frames_per_segment)
+{
+	if (!animation->resampled || frames_per_segment == 0)
+	{
+		DW_LOG_ERROR("Only resampled animations can be streamed : " + animation->name);
+		return false;
+	}
+
+	std::ofstream stream(path, std::ios::out | std::ios::binary);
+
+	if (!stream.is_open())
+	{
+		DW_LOG_ERROR("Failed to open file for writing : " + path);
+		return false;
+	}
+
+	uint32_t segment_count = (animation->frame_count - 2) / frames_per_segment + 1;
+
+	write_value(stream, (uint32_t)STREAMED_ANIMATION_MAGIC);
+	write_value(stream, (uint32_t)STREAMED_ANIMATION_VERSION);
+	write_value(stream, skeleton->hash());
+
+	write_string(stream, animation->name);
+	write_value(stream, animation->duration);
+	write_value(stream, animation->duration_in_ticks);
+	write_value(stream, animation->ticks_per_second);
+	write_value(stream, animation->sample_rate);
+	write_value(stream, animation->frame_count);
+	write_value(stream, animation->frame_stride);
+	write_value(stream, frames_per_segment);
+	write_value(stream, segment_count);
+
+	uint32_t frame_size = KEY_STREAM_COUNT * animation->frame_stride;
+
+	for (uint32_t segment = 0; segment < segment_count; segment++)
+	{
+		// The last segment is padded by repeating the final frame.
+		for (uint32_t i = 0; i <= frames_per_segment; i++)
+		{
+			uint32_t frame = std::min(segment * frames_per_segment + i, animation->frame_count - 1);
+			stream.write(reinterpret_cast<const char*>(animation->frame(frame)), sizeof(float) * frame_size);
+		}
+	}
+
+	return stream.good();
+}
+
+StreamedAnimation* StreamedAnimation::open(const std::string& path, Skeleton* skeleton)
+{
+	std::ifstream stream(path, std::ios::in | std::ios::binary);
+
+	if (!stream.is_open())
+		return nullptr;
+
+	uint32_t magic = 0;
+	uint32_t version = 0;
+	uint64_t skeleton_hash = 0;
+
+	if (!read_value(stream, magic) || !read_value(stream, version) || magic != STREAMED_ANIMATION_MAGIC || version != STREAMED_ANIMATION_VERSION)
+	{
+		DW_LOG_ERROR("Unsupported streamed animation : " + path);
+		return nullptr;
+	}
+
+	if (!read_value(stream, skeleton_hash) || skeleton_hash != skeleton->hash())
+	{
+		DW_LOG_ERROR("Streamed animation does not match skeleton : " + path);
+		return nullptr;
+	}
+
+	StreamedAnimation* animation = new StreamedAnimation();
+
+	read_string(stream, animation->name);
+	read_value(stream, animation->duration);
+	read_value(stream, animation->duration_in_ticks);
+	read_value(stream, animation->ticks_per_second);
+	read_value(stream, animation->sample_rate);
+	read_value(stream, animation->frame_count);
+	read_value(stream, animation->frame_stride);
+	read_value(stream, animation->frames_per_segment);
+	read_value(stream, animation->segment_count);
+
+	if (!stream.good())
+	{
+		DW_LOG_ERROR("Failed to read streamed animation : " + path);
+		delete animation;
+		return nullptr;
+	}
+
+	animation->m_path = path;
+	animation->m_data_offset = stream.tellg();
+
+	return animation;
+}
+
+bool StreamedAnimation::read_segment(uint32_t idx, float* frames) const
+{
+	std::ifstream stream(m_path, std::ios::in | std::ios::binary);
+
+	if (stream.is_open())
+	{
+		stream.seekg(m_data_offset + uint64_t(idx) * segment_size() * sizeof(float));
+		stream.read(reinterpret_cast<char*>(frames), sizeof(float) * segment_size());
+	}
+
+	if (!stream.good())
+	{
+		DW_LOG_ERROR("Failed to read segment " + std::to_string(idx) + " of streamed animation : " + m_path);
+		return false;
+	}
+
+	return true;
+}
+
+SegmentStreamer::SegmentStreamer(StreamedAnimation* animation) : m_animation(animation)
+{
+	// Both buffers are allocated up front, the read ahead writes into 'm_next' while 'm_current' is sampled.
+	m_current.resize(animation->segment_size());
+	m_next.resize(animation->segment_size());
+}
+
+SegmentStreamer::~SegmentStreamer()
+{
+	if (m_pending.valid())
+		m_pending.wait();
+}
+
+const float* SegmentStreamer::frame(uint32_t idx)
+{
+	int32_t segment = idx / m_animation->frames_per_segment;
+
+	if (segment != m_current_segment)
+	{
+		if (segment == m_failed_segment)
+			return nullptr;
+
+		bool next_read = m_pending.valid() && m_pending.get();
+
+		// Seeking (nothing resident covers this frame) or the read ahead failed. The segment is read into the spare
+		// buffer, so a short read never overwrites the current segment.
+		if (segment != m_next_segment || !next_read)
+		{
+			if (!m_animation->read_segment(segment, &m_next[0]))
+			{
+				m_next_segment = -1;
+				m_failed_segment = segment;
+				return nullptr;
+			}
+		}
+
+		std::swap(m_current, m_next);
+
+		m_current_segment = segment;
+		m_next_segment = -1;
+		m_failed_segment = -1;
+
+		// Playback loops, so the segment after the last one is the first.
+		int32_t next = (segment + 1) % m_animation->segment_count;
+
+		if (next != segment)
+			read_ahead(next);
+	}
+
+	return &m_current[(idx - segment * m_animation->frames_per_segment) * KEY_STREAM_COUNT * m_animation->frame_stride];
+}
+
+void SegmentStreamer::read_ahead(int32_t segment)
+{
+	StreamedAnimation* animation = m_animation;
+	float*			   frames = &m_next[0];
+
+	m_next_segment = segment;
+
+#if defined(__EMSCRIPTEN__)
+	// No threads to read on, the segment is read when it is first needed instead.
+	m_pending = std::async(std::launch::deferred, [animation, segment, frames]() { return animation->read_segment(segment, frames); });
+#else
+	m_pending = std::async(std::launch::async, [animation, segment, frames]() { return animation->read_segment(segment, frames); });
+#endif
+}
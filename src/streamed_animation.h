@@ -0,0 +1,73 @@
+#pragma once
+
+#include "animation.h"
+#include <future>
+
+#define STREAMED_ANIMATION_MAGIC 0x4D525453 // 'STRM'
+#define STREAMED_ANIMATION_VERSION 1
+
+class Skeleton;
+
+// A resampled clip that stays on disk and is split into fixed length time segments, each holding every channel
+// for a run of consecutive frames. Neighbouring segments share one frame so that both frames being interpolated
+// always live in the same segment.
+class StreamedAnimation
+{
+public:
+	// Writes a resampled clip as segments of 'frames_per_segment' frames each.
+	static bool bake(const std::string& path, Animation* animation, Skeleton* skeleton, uint32_t frames_per_segment);
+
+	// Only reads the header, segments are read on demand. Returns nullptr if the file is missing, was baked by another
+	// version of the format or targets a skeleton with a different hierarchy.
+	static StreamedAnimation* open(const std::string& path, Skeleton* skeleton);
+
+	// Reads a segment into 'frames', which must hold segment_size() floats. Opens its own file handle, so several
+	// segments can be read at once from different threads.
+	bool read_segment(uint32_t idx, float* frames) const;
+
+	// Number of floats in a segment.
+	inline uint32_t segment_size() const { return (frames_per_segment + 1) * KEY_STREAM_COUNT * frame_stride; }
+
+	std::string name;
+	double		duration;
+	double		duration_in_ticks;
+	double		ticks_per_second;
+	float		sample_rate;
+	uint32_t	frame_count;
+	uint32_t	frame_stride;
+	uint32_t	frames_per_segment;
+	uint32_t	segment_count;
+
+private:
+	std::string m_path;
+	uint64_t	m_data_offset;
+};
+
+// Keeps the segment being played and the one following it resident, so memory use per playing clip is two segments
+// whatever the length of the clip. The following segment is read in the background while the current one plays.
+class SegmentStreamer
+{
+public:
+	SegmentStreamer(StreamedAnimation* animation);
+	~SegmentStreamer();
+
+	// Start of the key streams of a frame, with the next frame laid out right after it. Only blocks when the frame is
+	// outside both resident segments (after a seek) or when the read ahead has not finished yet. Returns nullptr if the
+	// segment could not be read; the resident segments are left intact and the segment is not read again until playback
+	// moves on to another one, so callers hold their last pose.
+	const float* frame(uint32_t idx);
+
+	inline StreamedAnimation* animation() { return m_animation; }
+
+private:
+	void read_ahead(int32_t segment);
+
+private:
+	StreamedAnimation* m_animation;
+	std::vector<float> m_current;
+	std::vector<float> m_next;
+	int32_t			   m_current_segment = -1;
+	int32_t			   m_next_segment = -1;
+	int32_t			   m_failed_segment = -1;
+	std::future<bool>  m_pending;
+};
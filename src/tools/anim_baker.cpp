@@ -0,0 +1,157 @@
+#include "../animation.h"
+#include "../skeleton.h"
+#include "../keyframe_reduction.h"
+#include "../streamed_animation.h"
+#include <logger.h>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <memory>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+// Offline converter from FBX (or any format Assimp reads) to the baked skeleton and clip formats, so that the
+// runtime never has to import the source files.
+//
+// Usage:
+//   AnimationBaker <mesh> <output.skel> [--lod <joint,joint,...>]...
+//   AnimationBaker <mesh> <clip> <output.anim> [--additive <reference clip>] [--sample-rate <hz>] [--reduce <tolerance>] [--reduce-translation <tolerance>] [--reduce-rotation <tolerance>] [--reduce-scale <tolerance>] [--compress] [--stream <frames per segment>]
+//
+// Each '--lod' adds a bone LOD culling the listed joints and their descendants (see Skeleton::build_lods()). Clips have
+// to be baked with the same '--lod' options as the skeleton they are played on.
+//
+// '--reduce' removes keys within the same tolerance for every track type (see reduce_keyframes()), the other '--reduce-*'
+// options set the tolerance of a single track type and take precedence. Types without a tolerance use the default one.
+//
+// Resampled clips cannot be compressed, so '--compress' is ignored when a sample rate is given. '--stream' writes a
+// StreamedAnimation instead of a clip, resampled at 30 frames per second unless another rate is given.
+
+static void print_usage()
+{
+	std::cout << "Usage:" << std::endl;
+	std::cout << "  AnimationBaker <mesh> <output.skel> [--lod <joint,joint,...>]..." << std::endl;
+	std::cout << "  AnimationBaker <mesh> <clip> <output.anim> [--additive <reference clip>] [--sample-rate <hz>] [--reduce <tolerance>] [--reduce-translation <tolerance>] [--reduce-rotation <tolerance>] [--reduce-scale <tolerance>] [--compress] [--stream <frames per segment>]" << std::endl;
+}
+
+int main(int argc, const char* argv[])
+{
+	std::vector<std::string> paths;
+	std::string				 additive_reference;
+	float					 sample_rate = 0.0f;
+	float					 tolerance = 0.0f;
+	float					 track_tolerances[3] = { -1.0f, -1.0f, -1.0f }; // Translation, rotation and scale.
+	bool					 compress = false;
+	uint32_t				 frames_per_segment = 0;
+	std::vector<std::vector<std::string>> bone_lods;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--additive") == 0 && i + 1 < argc)
+			additive_reference = argv[++i];
+		else if (strcmp(argv[i], "--sample-rate") == 0 && i + 1 < argc)
+			sample_rate = atof(argv[++i]);
+		else if (strcmp(argv[i], "--reduce") == 0 && i + 1 < argc)
+			tolerance = atof(argv[++i]);
+		else if (strcmp(argv[i], "--reduce-translation") == 0 && i + 1 < argc)
+			track_tolerances[0] = atof(argv[++i]);
+		else if (strcmp(argv[i], "--reduce-rotation") == 0 && i + 1 < argc)
+			track_tolerances[1] = atof(argv[++i]);
+		else if (strcmp(argv[i], "--reduce-scale") == 0 && i + 1 < argc)
+			track_tolerances[2] = atof(argv[++i]);
+		else if (strcmp(argv[i], "--lod") == 0 && i + 1 < argc)
+		{
+			std::vector<std::string> joints;
+			std::stringstream		 list(argv[++i]);
+			std::string				 joint;
+
+			while (std::getline(list, joint, ','))
+				joints.push_back(joint);
+
+			bone_lods.push_back(joints);
+		}
+		else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc)
+			frames_per_segment = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--compress") == 0)
+			compress = true;
+		else
+			paths.push_back(argv[i]);
+	}
+
+	if (paths.size() != 2 && paths.size() != 3)
+	{
+		print_usage();
+		return 1;
+	}
+
+	std::unique_ptr<Skeleton> skeleton = std::unique_ptr<Skeleton>(Skeleton::create(paths[0]));
+
+	if (!skeleton)
+		return 1;
+
+	if (!bone_lods.empty())
+		skeleton->build_lods(bone_lods);
+
+	if (paths.size() == 2)
+	{
+		if (!skeleton->save(paths[1]))
+			return 1;
+
+		DW_LOG_INFO("Baked skeleton : " + paths[1]);
+		return 0;
+	}
+
+	std::unique_ptr<Animation> reference;
+
+	if (!additive_reference.empty())
+	{
+		reference = std::unique_ptr<Animation>(Animation::load(additive_reference, skeleton.get()));
+
+		if (!reference)
+			return 1;
+	}
+
+	KeyReductionSettings reduction;
+	bool				 reduce = tolerance > 0.0f;
+	float*				 settings_tolerances[3] = { &reduction.translation_tolerance, &reduction.rotation_tolerance, &reduction.scale_tolerance };
+
+	for (uint32_t i = 0; i < 3; i++)
+	{
+		if (track_tolerances[i] >= 0.0f)
+		{
+			*settings_tolerances[i] = track_tolerances[i];
+			reduce = true;
+		}
+		else if (tolerance > 0.0f)
+			*settings_tolerances[i] = tolerance;
+	}
+
+	std::unique_ptr<Animation> animation = std::unique_ptr<Animation>(Animation::load(paths[1], skeleton.get(), reference != nullptr, reference.get(), 0.0f, reduce ? &reduction : nullptr));
+
+	if (!animation)
+		return 1;
+
+	if (frames_per_segment > 0)
+	{
+		animation->resample(sample_rate > 0.0f ? sample_rate : 30.0f);
+
+		if (!StreamedAnimation::bake(paths[2], animation.get(), skeleton.get(), frames_per_segment))
+			return 1;
+
+		DW_LOG_INFO("Baked streamed animation : " + paths[2]);
+		return 0;
+	}
+
+	if (sample_rate > 0.0f)
+		animation->resample(sample_rate);
+	else if (compress)
+		animation->compress();
+
+	if (!animation->save(paths[2], skeleton.get()))
+		return 1;
+
+	DW_LOG_INFO("Baked animation : " + paths[2]);
+
+	return 0;
+}
@@ -0,0 +1,192 @@
+#include "../anim_simd.h"
+#include "../anim_blend.h"
+#include <logger.h>
+#include <algorithm>
+#include <random>
+#include <string>
+
+// Checks the vectorized blend kernels against their scalar references, for every blend mode with and without a bone
+// mask and for sparse joint lists. Rotations must match within ROTATION_TOLERANCE radians, translations and scales within
+// FLOAT_TOLERANCE.
+//
+// Usage:
+//   BlendTest
+
+#define NUM_JOINTS 67 // Not a multiple of SIMD_WIDTH, so the last lanes of the kernels are covered too.
+#define NUM_ITERATIONS 200
+#define MAX_POSES 16
+
+static const float ROTATION_TOLERANCE = 1e-5f;
+static const float FLOAT_TOLERANCE = 1e-5f;
+
+static std::mt19937 g_random(1234);
+
+static float random_float(float min, float max)
+{
+	return std::uniform_real_distribution<float>(min, max)(g_random);
+}
+
+static Keyframe random_keyframe()
+{
+	Keyframe keyframe;
+
+	keyframe.translation = glm::vec3(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f));
+	keyframe.rotation = glm::normalize(glm::quat(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f)));
+	keyframe.scale = glm::vec3(random_float(0.5f, 1.5f), random_float(0.5f, 1.5f), random_float(0.5f, 1.5f));
+
+	return keyframe;
+}
+
+// Angle of the rotation between 'a' and 'b'. Computed from the chord between the quaternions, since acos() of their dot
+// product is too coarse close to one for differences this small.
+static float rotation_error(const glm::quat& a, const glm::quat& b)
+{
+	glm::quat d = glm::dot(a, b) < 0.0f ? a + b : a - b;
+	return 4.0f * asinf(std::min(sqrtf(glm::dot(d, d)) * 0.5f, 1.0f));
+}
+
+static float float_error(const glm::vec3& a, const glm::vec3& b)
+{
+	glm::vec3 d = glm::abs(a - b);
+	return std::max(d.x, std::max(d.y, d.z));
+}
+
+struct Errors
+{
+	float rotation = 0.0f;
+	float value = 0.0f;
+
+	void add(const Keyframe& result, const Keyframe& reference)
+	{
+		rotation = std::max(rotation, rotation_error(result.rotation, reference.rotation));
+		value = std::max(value, std::max(float_error(result.translation, reference.translation), float_error(result.scale, reference.scale)));
+	}
+
+	bool passed() const { return rotation <= ROTATION_TOLERANCE && value <= FLOAT_TOLERANCE; }
+};
+
+// Blends the joints in 'joints' (all of them when empty) with blend_key_streams(), gathering them into consecutive lanes
+// like AnimBlend does, and compares each one with blend_keyframe(). 'mask' scales the blend factor per joint.
+static void test_pair(BlendMode mode, const float* mask, const std::vector<uint32_t>& joints, Errors& errors)
+{
+	static KeyStreamBuffer streams;
+	static Keyframe		   a[NUM_JOINTS];
+	static Keyframe		   b[NUM_JOINTS];
+	static Keyframe		   output[MAX_BONES];
+
+	uint32_t count = joints.empty() ? NUM_JOINTS : joints.size();
+	float	 t = random_float(0.0f, 1.0f);
+
+	for (uint32_t i = 0; i < NUM_JOINTS; i++)
+	{
+		a[i] = random_keyframe();
+		b[i] = random_keyframe();
+	}
+
+	for (uint32_t j = 0; j < count; j++)
+	{
+		uint32_t i = joints.empty() ? j : joints[j];
+
+		write_key_stream(streams.a, MAX_BONES, j, a[i]);
+		write_key_stream(streams.b, MAX_BONES, j, b[i]);
+
+		streams.factors[j] = mask ? t * mask[i] : t;
+	}
+
+	blend_key_streams(streams.a, streams.b, MAX_BONES, streams.factors, count, mode, output);
+
+	for (uint32_t j = 0; j < count; j++)
+	{
+		uint32_t i = joints.empty() ? j : joints[j];
+		errors.add(output[j], blend_keyframe(a[i], b[i], streams.factors[j], mode));
+	}
+}
+
+// Compares the SIMD path of AnimBlend::blend_weighted() with its scalar loop.
+static void test_weighted(uint32_t count, Errors& errors)
+{
+	static Pose poses[MAX_POSES];
+	const Pose* inputs[MAX_POSES];
+	float		weights[MAX_POSES];
+
+	AnimBlend scalar(nullptr);
+	AnimBlend simd(nullptr);
+
+	simd.set_simd(true);
+
+	for (uint32_t p = 0; p < count; p++)
+	{
+		poses[p].num_keyframes = NUM_JOINTS;
+
+		for (uint32_t i = 0; i < NUM_JOINTS; i++)
+			poses[p].keyframes[i] = random_keyframe();
+
+		inputs[p] = &poses[p];
+		weights[p] = random_float(0.0f, 1.0f);
+	}
+
+	const Pose* reference = scalar.blend_weighted(inputs, weights, count);
+	const Pose* result = simd.blend_weighted(inputs, weights, count);
+
+	for (uint32_t i = 0; i < NUM_JOINTS; i++)
+		errors.add(result->keyframes[i], reference->keyframes[i]);
+}
+
+static bool report(const std::string& name, const Errors& errors)
+{
+	std::string message = name + " : rotation error " + std::to_string(errors.rotation) + " rad, translation/scale error " + std::to_string(errors.value);
+
+	if (errors.passed())
+		DW_LOG_INFO("PASSED " + message);
+	else
+		DW_LOG_ERROR("FAILED " + message);
+
+	return errors.passed();
+}
+
+int main()
+{
+	const BlendMode	  modes[] = { BLEND_MODE_LERP, BLEND_MODE_ADDITIVE, BLEND_MODE_ADDITIVE_WITH_REFERENCE };
+	const std::string mode_names[] = { "lerp", "additive", "additive with reference" };
+
+	// Graded mask with unmasked joints, as built by BoneMask.
+	float mask[NUM_JOINTS];
+
+	for (uint32_t i = 0; i < NUM_JOINTS; i++)
+		mask[i] = i % 4 == 0 ? 0.0f : (i % 4) / 3.0f;
+
+	// Every third joint, like the additive joints of a clip.
+	std::vector<uint32_t> sparse_joints;
+
+	for (uint32_t i = 1; i < NUM_JOINTS; i += 3)
+		sparse_joints.push_back(i);
+
+	bool passed = true;
+
+	for (uint32_t m = 0; m < 3; m++)
+	{
+		Errors full;
+		Errors masked;
+		Errors sparse;
+
+		for (uint32_t i = 0; i < NUM_ITERATIONS; i++)
+		{
+			test_pair(modes[m], nullptr, std::vector<uint32_t>(), full);
+			test_pair(modes[m], mask, std::vector<uint32_t>(), masked);
+			test_pair(modes[m], mask, sparse_joints, sparse);
+		}
+
+		passed &= report(mode_names[m], full);
+		passed &= report(mode_names[m] + ", masked", masked);
+		passed &= report(mode_names[m] + ", masked and sparse", sparse);
+	}
+
+	Errors weighted;
+
+	for (uint32_t i = 0; i < NUM_ITERATIONS; i++)
+		test_weighted(2 + i % (MAX_POSES - 1), weighted);
+
+	passed &= report("weighted", weighted);
+
+	return passed ? 0 : 1;
+}